@@ -0,0 +1,67 @@
+#pragma once
+#ifndef __ACTIVITY_REGION_H__
+#define __ACTIVITY_REGION_H__
+
+#include <cmath>
+#include <vector>
+
+#include "SpatialGrid.hpp"
+
+// The part of a world that is simulated: the square of entities not farther than radius
+// from the center along either axis. The others are dormant: systems leave them as they
+// are, so they go on from the same state once they are back in the region, whatever the
+// frames in between were. The cost of an update then follows what is near the center,
+// not the size of the world. Unbounded till a radius is set.
+// Guarded like positions: the system that moves the center writes them, the systems that
+// ask it read them
+class ActivityRegion
+{
+    float _centerX;
+    float _centerY;
+    float _radius;
+
+public:
+
+    ActivityRegion():
+        _centerX (0.f),
+        _centerY (0.f),
+        _radius (INFINITY)
+    {}
+
+    void SetRadius (float radius)
+    {
+        _radius = radius;
+    }
+
+    inline float GetRadius() const
+    {
+        return _radius;
+    }
+
+    inline void MoveTo (float x, float y)
+    {
+        _centerX = x;
+        _centerY = y;
+    }
+
+    // World::RebaseOrigin() moves it along with the coordinates
+    inline void Shift (float dx, float dy)
+    {
+        _centerX += dx;
+        _centerY += dy;
+    }
+
+    inline bool Contains (float x, float y) const
+    {
+        return x >= _centerX - _radius && x <= _centerX + _radius       // the way Query() tells
+            && y >= _centerY - _radius && y <= _centerY + _radius;
+    }
+
+    // Appends the entities of grid in the region, in no particular order
+    void Query (const SpatialGrid& grid, std::vector<entity_id_t>& result) const
+    {
+        grid.QueryAABB(_centerX - _radius, _centerY - _radius, _centerX + _radius, _centerY + _radius, result);
+    }
+};
+
+#endif // ! __ACTIVITY_REGION_H__
@@ -0,0 +1,100 @@
+#pragma once
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+#include <atomic>
+
+// Simulation time for systems and the system scheduler. Starts at 0.
+//     REAL_TIME   follows the monotonic clock
+//     FIXED_STEP  advances by a constant step on every frame
+//     MANUAL      advances only through Advance()
+class WorldClock
+{
+public:
+
+    enum Mode
+    {
+        REAL_TIME,
+        FIXED_STEP,
+        MANUAL
+    };
+
+private:
+
+    Mode _mode;
+    std::atomic<int64_t> _time_nsec;        // simulation time at _anchor_nsec in REAL_TIME mode
+    int64_t _anchor_nsec;
+    int64_t _step_nsec;
+
+    void Rebase (Mode mode)
+    {
+        _time_nsec = Now_nsec();
+        _anchor_nsec = GetMonotonicTime_nsec();
+        _mode = mode;
+    }
+
+public:
+
+    WorldClock():
+        _mode (REAL_TIME),
+        _time_nsec (0),
+        _anchor_nsec (GetMonotonicTime_nsec()),
+        _step_nsec (0)
+    {}
+
+    inline Mode GetMode() const
+    {
+        return _mode;
+    }
+
+    void SetRealTime()
+    {
+        Rebase(REAL_TIME);
+    }
+
+    void SetFixedStep (float step_sec)
+    {
+        Rebase(FIXED_STEP);
+        _step_nsec = (int64_t)(step_sec * 1e9);
+    }
+
+    void SetManual()
+    {
+        Rebase(MANUAL);
+    }
+
+    int64_t Now_nsec() const
+    {
+        if (_mode == REAL_TIME)
+            return _time_nsec + GetMonotonicTime_nsec() - _anchor_nsec;
+        return _time_nsec;
+    }
+
+    inline float Now_sec() const
+    {
+        return Now_nsec() / 1e9f;
+    }
+
+    // Only in MANUAL mode, time never goes back
+    void Advance (int64_t delta_nsec)
+    {
+        if (_mode == MANUAL && delta_nsec > 0)
+            _time_nsec += delta_nsec;
+    }
+
+    // Called by SystemManager before each frame
+    void NextFrame()
+    {
+        if (_mode == FIXED_STEP)
+            _time_nsec += _step_nsec;
+    }
+
+};
+
+// of the current world
+inline WorldClock& GetWorldClock()
+{
+    return *World::GetCurrent()._clock;
+}
+
+#endif // ! __CLOCK_H__
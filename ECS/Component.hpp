@@ -46,6 +46,8 @@ class ComponentManager
 
     std::vector<std::vector<IComponent*>> componentsOfEntities; // Entity ID to component IDs
     std::vector<std::vector<IComponent*>> componentObjectPointersByComponent; //[componentTypeId][entityObjectId] = pointer to component object of given entity
+    std::vector<int> componentsCount; //[componentTypeId] = number of components of the type
+    std::vector<uint64_t> componentsVersion; //[componentTypeId] = number of additions and removals of components of the type
     int componentTypesCount;
 
     template <typename T>
@@ -80,6 +82,8 @@ public:
 
         for (int i = 0; i < componentTypesCount; i++)
             componentObjectPointersByComponent.push_back(std::vector<IComponent*>());
+        componentsCount.assign(componentTypesCount, 0);
+        componentsVersion.assign(componentTypesCount, 0);
  
     }
 
@@ -97,6 +101,7 @@ public:
     template <typename ComponentName, typename... Args>
     ComponentName*             AddComponent       (entity_id_t entityId, Args... args)
     {
+        PROFILE_ZONE(TypeName<ComponentName>(), "AddComponent")
         ComponentName* component = new ComponentName(entityId, args...);
         LOG_LEEKS _LOG( "Allocating %lu bytes at [%p] from %s\n", sizeof(*component), component, __PRETTY_FUNCTION__);
 
@@ -106,6 +111,8 @@ public:
         int componentTypeId = Component<ComponentName>::COMPONENT_TYPE_ID;
         ExpandVector_initialised<IComponent*> ((this->componentObjectPointersByComponent)[componentTypeId], entityId + 1, nullptr);
         this->componentObjectPointersByComponent[Component<ComponentName>::COMPONENT_TYPE_ID][entityId] = dynamic_cast<IComponent*>(component);
+        this->componentsCount[componentTypeId]++;
+        this->componentsVersion[componentTypeId]++;
 
         return component;
 
@@ -118,6 +125,8 @@ public:
         delete component;
         LOG_LEEKS _LOG( "Deleting [%p] from %s\n", component, __PRETTY_FUNCTION__);
         THIS_COMPONENT = nullptr;
+        this->componentsCount[Component<ComponentName>::COMPONENT_TYPE_ID]--;
+        this->componentsVersion[Component<ComponentName>::COMPONENT_TYPE_ID]++;
         for (int i = 0; i < this->componentsOfEntities[entityId].size(); i++)
             if (this->componentsOfEntities[entityId][i] == component)
             {
@@ -143,6 +152,21 @@ public:
         return this->componentObjectPointersByComponent[Component<ComponentName>::COMPONENT_TYPE_ID];
     }
 
+    template <typename ComponentName>
+    int GetComponentsCount() const
+    {
+        return this->componentsCount[Component<ComponentName>::COMPONENT_TYPE_ID];
+    }
+
+    // Changes whenever a component of any of the types is added or removed
+    uint64_t GetComponentsVersion (const std::vector<component_t_id_t>& componentTypeIds) const
+    {
+        uint64_t version = 0;
+        for (component_t_id_t componentTypeId : componentTypeIds)
+            version += this->componentsVersion[componentTypeId];
+        return version;
+    }
+
     std::vector<IComponent*> const& GetComponentsVector (entity_id_t entityId) const
     {
         return this->componentsOfEntities[entityId];
@@ -158,16 +182,52 @@ public:
             {
                 delete (IComponent*)(this->componentObjectPointersByComponent[i][entityId]);
                 this->componentObjectPointersByComponent[i][entityId] = nullptr; //TODO: сокращать вектор
+                this->componentsCount[i]--;
+                this->componentsVersion[i]++;
                 putchar(0);
             }
         }
     }
 
+    // Of several distinct entities at once, pool by pool
+    void RemoveComponentsOf (const std::vector<entity_id_t>& entityIds)
+    {
+        int entitiesCount = this->componentsOfEntities.size();
+        for (entity_id_t entityId : entityIds)
+            if (entityId < entitiesCount)
+                this->componentsOfEntities[entityId].clear();
+
+        int poolsCount = this->componentObjectPointersByComponent.size();
+        for (int i = 0; i < poolsCount; i++)
+        {
+            std::vector<IComponent*>& components = this->componentObjectPointersByComponent[i];
+            int size = components.size();
+            int removed = 0;
+            for (entity_id_t entityId : entityIds)
+                if (entityId < size && components[entityId])
+                {
+                    delete components[entityId];
+                    components[entityId] = nullptr;
+                    removed++;
+                }
+
+            if (removed)
+            {
+                this->componentsCount[i] -= removed;
+                this->componentsVersion[i]++;
+            }
+        }
+    }
+
 
 
 };
 
-ComponentManager componentManager;
+// of the current world
+inline ComponentManager& GetComponentManager()
+{
+    return *World::GetCurrent()._componentManager;
+}
 
 #endif // ! __COMPONENT_H__
 
@@ -0,0 +1,261 @@
+#pragma once
+#ifndef __COROUTINE_H__
+#define __COROUTINE_H__
+
+#include <coroutine>
+#include <chrono>
+#include <exception>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <cmath>
+
+// Return type of CoroutineSystem::Run(). Owns the coroutine frame
+class SystemTask
+{
+public:
+
+    struct promise_type
+    {
+        SystemTask get_return_object()
+        {
+            return SystemTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+private:
+
+    std::coroutine_handle<promise_type> _handle;
+
+public:
+
+    SystemTask():
+        _handle (nullptr)
+    {}
+
+    explicit SystemTask (std::coroutine_handle<promise_type> handle):
+        _handle (handle)
+    {}
+
+    SystemTask (SystemTask&& rhs) noexcept:
+        _handle (rhs._handle)
+    {
+        rhs._handle = nullptr;
+    }
+
+    SystemTask& operator= (SystemTask&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            if (_handle)
+                _handle.destroy();
+            _handle = rhs._handle;
+            rhs._handle = nullptr;
+        }
+        return *this;
+    }
+
+    SystemTask (const SystemTask&) = delete;
+    SystemTask& operator= (const SystemTask&) = delete;
+
+    ~SystemTask()
+    {
+        if (_handle)
+            _handle.destroy();
+    }
+
+    inline bool IsStarted() const
+    {
+        return (bool)_handle;
+    }
+
+    inline bool IsDone() const
+    {
+        return _handle && _handle.done();
+    }
+
+    inline void Resume()
+    {
+        _handle.resume();
+    }
+};
+
+// A system written as a coroutine: Run() is resumed only when what it awaits is ready
+//     co_await events.Next<GameOver>()            the next GameOver raised for this system
+//     co_await events.Next<EnterPressed, ...>()   the next one of several types, in order of raising
+//     co_await Delay(3s)                          3 seconds of world time
+//     co_await NextFrame()                        the next update of the system
+// While it waits for events the system is dormant and costs nothing, raised events wake it.
+// An awaited event stays valid till the next co_await. The system must be subscribed to
+// the events it awaits; other events raised for it wait for a co_await that takes them
+template <typename SystemName>
+class CoroutineSystem: public System<SystemName>, public IEventListener
+{
+    enum Awaiting
+    {
+        FRAME,
+        TIME,
+        EVENT
+    };
+
+    SystemTask _task;
+    Awaiting _awaiting;
+    int64_t _resumeTime_nsec;
+    std::vector<id_t> _awaitedEventTypes;
+    id_t _takenEventId;                 // NO_EVENT_ID if none, handled when the coroutine suspends again
+    IEvent* _takenEvent;
+
+    bool TakeAwaitedEvent()
+    {
+        int size = this->_raisedEvents.size();
+        for (int i = 0; i < size; i++)
+        {
+            IEvent* event = this->_eventManager.GetEvent(this->_raisedEvents[i]);
+            for (id_t eventTypeId : _awaitedEventTypes)
+                if (event->_eventTypeId == eventTypeId)
+                {
+                    _takenEventId = this->_raisedEvents[i];
+                    _takenEvent = event;
+                    this->_raisedEvents.erase(this->_raisedEvents.begin() + i);
+                    return true;
+                }
+        }
+        return false;
+    }
+
+    bool IsReady (bool sameUpdate)
+    {
+        switch (_awaiting)
+        {
+            case FRAME: return !sameUpdate;
+            case TIME:  return this->_worldClock.Now_nsec() >= _resumeTime_nsec;
+            case EVENT: return TakeAwaitedEvent();
+        }
+        return false;
+    }
+
+protected:
+
+    struct FrameAwaiter
+    {
+        CoroutineSystem* _system;
+
+        bool await_ready() const { return false; }
+        void await_suspend (std::coroutine_handle<>) { _system->_awaiting = FRAME; }
+        void await_resume() const {}
+    };
+
+    struct DelayAwaiter
+    {
+        CoroutineSystem* _system;
+        int64_t _delay_nsec;
+
+        bool await_ready() const { return _delay_nsec <= 0; }
+        void await_suspend (std::coroutine_handle<>)
+        {
+            _system->_awaiting = TIME;
+            _system->_resumeTime_nsec = _system->_worldClock.Now_nsec() + _delay_nsec;
+        }
+        void await_resume() const {}
+    };
+
+    // EventName* for one event type, IEvent* for several
+    template <typename... EventNames>
+    struct EventAwaiter
+    {
+        typedef typename std::conditional<sizeof...(EventNames) == 1,
+                                          typename std::tuple_element<0, std::tuple<EventNames...>>::type,
+                                          IEvent>::type Result;
+
+        CoroutineSystem* _system;
+
+        bool await_ready() const { return false; }
+        void await_suspend (std::coroutine_handle<>)
+        {
+            _system->_awaiting = EVENT;
+            _system->_awaitedEventTypes = { Event<EventNames>::EVENT_TYPE_ID... };
+        }
+        Result* await_resume() const { return static_cast<Result*>(_system->_takenEvent); }
+    };
+
+    class Events
+    {
+        CoroutineSystem* _system;
+
+    public:
+
+        Events (CoroutineSystem* system):
+            _system (system)
+        {}
+
+        template <typename... EventNames>
+        EventAwaiter<EventNames...> Next()
+        {
+            return EventAwaiter<EventNames...> { _system };
+        }
+    } events;
+
+    FrameAwaiter NextFrame()
+    {
+        return FrameAwaiter { this };
+    }
+
+    template <typename Rep, typename Period>
+    DelayAwaiter Delay (std::chrono::duration<Rep, Period> delay)
+    {
+        return DelayAwaiter { this, std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count() };
+    }
+
+    virtual SystemTask Run() = 0;
+
+public:
+
+    CoroutineSystem (World& world):
+        System<SystemName> (world),
+        _awaiting (FRAME),
+        _resumeTime_nsec (0),
+        _takenEventId (NO_EVENT_ID),
+        _takenEvent (nullptr),
+        events (this)
+    {
+        this->_updateInterval = 0;
+    }
+
+    virtual ~CoroutineSystem()
+    {}
+
+    virtual float Update() override
+    {
+        if (!_task.IsStarted())
+            _task = Run();
+
+        for (bool sameUpdate = false; !_task.IsDone() && IsReady(sameUpdate); sameUpdate = true)
+        {
+            _task.Resume();
+            if (_takenEventId != NO_EVENT_ID)
+            {
+                this->_eventManager.EventHandled(_takenEventId, *this);
+                _takenEventId = NO_EVENT_ID;
+                _takenEvent = nullptr;
+            }
+        }
+
+        if (_task.IsDone())
+            return INFINITY;
+
+        switch (_awaiting)
+        {
+            case FRAME: return 0;
+            case TIME:  return (_resumeTime_nsec - this->_worldClock.Now_nsec()) / 1e6f;
+            case EVENT: return INFINITY;        // dormant till an event wakes it
+        }
+        return 0;
+    }
+};
+
+#endif // ! __COROUTINE_H__
@@ -1,5 +1,7 @@
 #include <cstdio>
 #include <cstring> //for memset(), memmove()
+#include <ctime>
+#include <string>
 #include <vector>
 
 // Include doubly linked list library
@@ -34,9 +36,60 @@ struct Vector2
 };
 
 
+inline int64_t GetMonotonicTime_nsec()
+{
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000LL + time.tv_nsec;
+}
+
+// "MovingSystem" for TypeName<MovingSystem>(), taken from __PRETTY_FUNCTION__ once per type
+inline std::string ExtractTypeName (const char* prettyFunction)
+{
+    std::string function = prettyFunction;
+    size_t begin = function.find("T = ");
+    if (begin == std::string::npos)
+        return function;
+    begin += 4;
+    return function.substr(begin, function.find_first_of(";]", begin) - begin);
+}
+
+template <typename T>
+const char* TypeName()
+{
+    static const std::string name = ExtractTypeName(__PRETTY_FUNCTION__);
+    return name.c_str();
+}
+
+
 #include "IDManager.hpp"
 
 
+///---------------------------------------------------------------------------------
+///-------------------------             World            --------------------------
+#include "World.hpp"
+
+
+///---------------------------------------------------------------------------------
+///-------------------------           Profiler           --------------------------
+#include "Profiler.hpp"
+
+
+///---------------------------------------------------------------------------------
+///-------------------------             Clock            --------------------------
+#include "Clock.hpp"
+
+
+///---------------------------------------------------------------------------------
+///-------------------------          FramePacer          --------------------------
+#include "FramePacer.hpp"
+
+
+///---------------------------------------------------------------------------------
+///-------------------------         TripleBuffer         --------------------------
+#include "TripleBuffer.hpp"
+
+
 ///---------------------------------------------------------------------------------
 ///-------------------------           Component          --------------------------
 #include "Component.hpp"
@@ -47,6 +100,44 @@ struct Vector2
 #include "Entity.hpp"
 
 
+///---------------------------------------------------------------------------------
+///-------------------------          SpatialGrid         --------------------------
+#include "SpatialGrid.hpp"
+
+// of the current world
+inline SpatialGrid& GetSpatialGrid()
+{
+    return *World::GetCurrent()._spatialGrid;
+}
+
+
+///---------------------------------------------------------------------------------
+///-------------------------        FloatingOrigin        --------------------------
+#include "FloatingOrigin.hpp"
+
+// of the current world
+inline FloatingOrigin& GetWorldOrigin()
+{
+    return *World::GetCurrent()._origin;
+}
+
+
+///---------------------------------------------------------------------------------
+///-------------------------        ActivityRegion        --------------------------
+#include "ActivityRegion.hpp"
+
+// of the current world
+inline ActivityRegion& GetActivityRegion()
+{
+    return *World::GetCurrent()._activity;
+}
+
+
+///---------------------------------------------------------------------------------
+///-------------------------         EntityGroups         --------------------------
+#include "EntityGroups.hpp"
+
+
 
 ///---------------------------------------------------------------------------------
 ///-----------------------------         Event          ----------------------------
@@ -54,15 +145,76 @@ struct Vector2
 #include "Event.hpp"
 
 
+///---------------------------------------------------------------------------------
+///-----------------------------      JobSystem        -----------------------------
+
+#include "JobSystem.hpp"
+
+
+///---------------------------------------------------------------------------------
+///-----------------------------      WorkQueue        -----------------------------
+
+#include "WorkQueue.hpp"
+
+
 ///---------------------------------------------------------------------------------
 ///-----------------------------        System         -----------------------------
 
 #include "System.hpp"
 
 
+///---------------------------------------------------------------------------------
+///-----------------------------      Coroutine        -----------------------------
+
+#include "Coroutine.hpp"
+
+
+World::World():
+    _clock (new WorldClock()),
+    _componentManager (new ComponentManager()),
+    _entityManager (new EntityManager(*_componentManager)),
+    _eventManager (new EventManager()),
+    _systemManager (new SystemManager(this)),
+    _spatialGrid (new SpatialGrid()),
+    _origin (new FloatingOrigin()),
+    _activity (new ActivityRegion())
+{}
+
+World::~World()
+{
+    Scope scope (*this);        // systems and entities may reach their world while being deleted
+    delete _systemManager;
+    delete _eventManager;
+    delete _entityManager;
+    delete _componentManager;
+    delete _spatialGrid;
+    delete _origin;
+    delete _activity;
+    delete _clock;
+}
+
+// After all the component, system and event types got their IDs
+void World::Setup()
+{
+    _componentManager->Setup();
+    _systemManager->Setup();
+    _eventManager->Setup();
+}
+
+// Positions kept in chunks stay where they are; float coordinates, the ones in the
+// spatial index and of the activity region too, move by the chunks the origin did
+void World::RebaseOrigin (int64_t chunk)
+{
+    int64_t chunks = chunk - _origin->GetChunk();
+    _origin->Rebase(chunk);
+    _spatialGrid->Shift(-(float)chunks * _origin->GetChunkSize(), 0.f);
+    _activity->Shift(-(float)chunks * _origin->GetChunkSize(), 0.f);
+}
+
+World mainWorld;
+
+// Sets up the current world
 void SetupManagers()
 {
-    componentManager.Setup();
-    systemManager.Setup();
-    eventManager.Setup();
+    World::GetCurrent().Setup();
 }
\ No newline at end of file
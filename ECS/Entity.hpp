@@ -45,6 +45,7 @@ entity_t_id_t const Entity<EntityName>::ENTITY_TYPE_ID = entityIdManager.GetUniq
 class EntityManager
 {
     List entityObjectIndexes;
+    ComponentManager& _componentManager;     // of the same world, has the components of the entities
 
     inline int GetTotalObjectsCount()
     {
@@ -53,7 +54,8 @@ class EntityManager
 
 public:
 
-    EntityManager()
+    EntityManager (ComponentManager& componentManager):
+        _componentManager (componentManager)
     {
         MakeList(&entityObjectIndexes, "EntityManager");
     }
@@ -90,7 +92,8 @@ public:
 
     int DestroyEntityObject (entity_id_t Id)
     {
-        componentManager.RemoveComponentsOf(Id);
+        PROFILE_ZONE("DestroyEntityObject", "entity")
+        _componentManager.RemoveComponentsOf(Id);
         IEntity* entity = nullptr;
         _LOG("LIST: removing from %d\n", Id);
         int ret = RemoveAtPos(&entityObjectIndexes, Id, (void**)&entity);
@@ -102,9 +105,30 @@ public:
         return ret;
     }
 
+    // Ids must be distinct
+    void DestroyEntityObjects (const std::vector<entity_id_t>& Ids)
+    {
+        PROFILE_ZONE("DestroyEntityObjects", "entity")
+        _componentManager.RemoveComponentsOf(Ids);
+        for (entity_id_t Id : Ids)
+        {
+            IEntity* entity = nullptr;
+            _LOG("LIST: removing from %d\n", Id);
+            if (RemoveAtPos(&entityObjectIndexes, Id, (void**)&entity) >= 0)
+            {
+                LOG_LEEKS _LOG( "Deleting [%p] from %s\n", entity, __PRETTY_FUNCTION__);
+                delete entity;
+            }
+        }
+    }
+
 };
 
-EntityManager entityManager; //TODO: namespace
+// of the current world
+inline EntityManager& GetEntityManager()
+{
+    return *World::GetCurrent()._entityManager;
+}
 
 #endif // ! __ENTITY_H__
 
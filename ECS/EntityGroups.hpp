@@ -0,0 +1,68 @@
+#pragma once
+#ifndef __ENTITY_GROUPS_H__
+#define __ENTITY_GROUPS_H__
+
+#include <unordered_map>
+#include <vector>
+
+// Entities grouped under keys, as turrets under the chunks they stand in, so that a whole
+// group is found or taken at once instead of searched for entity by entity. A group's
+// memory goes with it when it is taken. Groups don't follow the entities: whoever groups
+// them takes them out before destroying them some other way
+template <typename Key>
+class EntityGroups
+{
+    std::unordered_map<Key, std::vector<entity_id_t>> _groups;
+    int _count;
+
+public:
+
+    EntityGroups():
+        _count (0)
+    {}
+
+    inline int GetCount() const
+    {
+        return _count;
+    }
+
+    inline int GetGroupsCount() const
+    {
+        return (int)_groups.size();
+    }
+
+    void Add (const Key& key, entity_id_t entityId)
+    {
+        _groups[key].push_back(entityId);
+        _count++;
+    }
+
+    // nullptr if there is no such group
+    const std::vector<entity_id_t>* Find (const Key& key) const
+    {
+        auto group = _groups.find(key);
+        return group == _groups.end() ? nullptr : &group->second;
+    }
+
+    // Appends the entities of the group to entityIds, in the order they were added, and drops the group
+    void Take (const Key& key, std::vector<entity_id_t>& entityIds)
+    {
+        auto group = _groups.find(key);
+        if (group == _groups.end())
+            return;
+        entityIds.insert(entityIds.end(), group->second.begin(), group->second.end());
+        _count -= (int)group->second.size();
+        _groups.erase(group);
+    }
+
+    // Appends the entities of all the groups, group by group in no particular order, and drops them
+    void TakeAll (std::vector<entity_id_t>& entityIds)
+    {
+        for (auto& group : _groups)
+            entityIds.insert(entityIds.end(), group.second.begin(), group.second.end());
+        _groups.clear();
+        _count = 0;
+    }
+};
+
+#endif // ! __ENTITY_GROUPS_H__
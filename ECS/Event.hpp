@@ -3,6 +3,7 @@
 #define __EVENT_H__
 
 #include <vector>
+#include <mutex>
 #include "../../lib/The List.h"
 
 class IEvent
@@ -43,6 +44,11 @@ public:
 template <typename EventName>
 id_t const Event<EventName>::EVENT_TYPE_ID = eventIdManager.GetUniqueID();
 
+// The id of no event, for ids that may be unset
+const id_t NO_EVENT_ID = (id_t)-1;
+
+
+class ISystem;
 
 class IEventListener
 {
@@ -50,14 +56,22 @@ class IEventListener
 public:
 
     std::vector<id_t> _raisedEvents;
+    ISystem* _wakesUp;          // the system this listener is, woken up by raised events if dormant
+
+    IEventListener():
+        _wakesUp (nullptr)
+    {}
 
-    ~IEventListener()
+    virtual ~IEventListener()
     {
         _LOG("Deleting IEventListener [%p]\n", this);
         if (_raisedEvents.size() > 0)
             _LOG("ACHTUNG: %d event(s) haven't been handled\n", _raisedEvents.size());
     }
 
+    // Called by SendEvent after the event is added to _raisedEvents. Defined in System.hpp
+    virtual void OnEventRaised();
+
 };
 //TODO: void* -> interface*, виртуальные деструкторы для корректности удаления объектов, виртуальные другие функции
 class EventManager
@@ -65,6 +79,7 @@ class EventManager
     List _eventPointers;
     //std::vector<IEvent*>* eventObjectsByTypes;
     std::vector<IEventListener*>* _eventListenersByTypes;
+    std::mutex _mutex;      // systems without conflicts send and handle events concurrently
 
 public:
 
@@ -102,6 +117,7 @@ public:
 
     IEvent* GetEvent(id_t id)
     {
+        std::lock_guard<std::mutex> lock(_mutex);
         return (IEvent*) GetByPhInd(&this->_eventPointers, id);
     }
 
@@ -117,13 +133,18 @@ public:
     template <typename EventName, typename... Args>
     id_t SendEvent (/*entity_id_t entityId, */Args... args)
     {
+        PROFILE_ZONE(TypeName<EventName>(), "event")
         EventName* event = new EventName(args...);
         LOG_LEEKS _LOG( "Allocating %lu bytes at [%p] from %s\n", sizeof(*event) * 1, event, __PRETTY_FUNCTION__);
+        std::lock_guard<std::mutex> lock(_mutex);
         id_t eventId = AddToEnd(&_eventPointers, event);
 
         event->unhandlingsCount = this->_eventListenersByTypes[Event<EventName>::EVENT_TYPE_ID].size();
         for (IEventListener* listener : this->_eventListenersByTypes[Event<EventName>::EVENT_TYPE_ID])
+        {
             listener->_raisedEvents.push_back(eventId);
+            listener->OnEventRaised();
+        }
 
         return eventId;
 
@@ -131,6 +152,7 @@ public:
 
     void EventHandled (id_t eventId, const IEventListener& eventListener)
     {
+        std::lock_guard<std::mutex> lock(_mutex);
         IEvent* event = (IEvent*)GetByPhInd(&this->_eventPointers, eventId);
         event->unhandlingsCount--;
         if (event->unhandlingsCount == 0)
@@ -143,7 +165,11 @@ public:
 
 };
 
-EventManager eventManager;
+// of the current world
+inline EventManager& GetEventManager()
+{
+    return *World::GetCurrent()._eventManager;
+}
 
 #endif // ! __EVENT_H__
 
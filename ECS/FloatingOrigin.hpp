@@ -0,0 +1,70 @@
+#pragma once
+#ifndef __FLOATING_ORIGIN_H__
+#define __FLOATING_ORIGIN_H__
+
+#include <cmath>
+#include <cstdint>
+
+// The chunk float coordinates of a world count from, along the axis the world stretches.
+// Far from it floats lose precision, so a world that goes far keeps the origin near the
+// player. Positions kept as a chunk index and an offset in the chunk don't depend on the
+// origin: moving it changes nothing but the index, and their floats are exact near it.
+// Distances that must not lose precision at all are kept absolute, in doubles
+class FloatingOrigin
+{
+    float _chunkSize;
+    int64_t _chunk;
+
+public:
+
+    FloatingOrigin (float chunkSize = 256.f):
+        _chunkSize (chunkSize),
+        _chunk (0)
+    {}
+
+    // before any position is kept in chunks
+    void SetChunkSize (float chunkSize)
+    {
+        _chunkSize = chunkSize;
+    }
+
+    inline float GetChunkSize() const
+    {
+        return _chunkSize;
+    }
+
+    inline int64_t GetChunk() const
+    {
+        return _chunk;
+    }
+
+    // World::RebaseOrigin() moves the spatial index along
+    inline void Rebase (int64_t chunk)
+    {
+        _chunk = chunk;
+    }
+
+    inline float ToFloat (int64_t chunk, float offset) const
+    {
+        return (float)(chunk - _chunk) * _chunkSize + offset;
+    }
+
+    inline void ToChunk (float coordinate, int64_t& chunk, float& offset) const
+    {
+        int64_t chunks = (int64_t)std::floor(coordinate / _chunkSize);
+        chunk = _chunk + chunks;
+        offset = coordinate - (float)chunks * _chunkSize;
+    }
+
+    inline double ToAbsolute (float coordinate) const
+    {
+        return (double)_chunk * _chunkSize + coordinate;
+    }
+
+    inline float FromAbsolute (double absolute) const
+    {
+        return (float)(absolute - (double)_chunk * _chunkSize);
+    }
+};
+
+#endif // ! __FLOATING_ORIGIN_H__
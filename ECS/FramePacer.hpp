@@ -0,0 +1,150 @@
+#pragma once
+#ifndef __FRAME_PACER_H__
+#define __FRAME_PACER_H__
+
+#include <cstdio>
+#include <cmath>
+#include <cerrno>
+#include <ctime>
+
+// Sleeps till absolute deadlines on CLOCK_MONOTONIC, so time spent in updates and
+// wakeup latency don't pile up from frame to frame. The last _spin_nsec before a
+// deadline are spent spinning instead of sleeping
+class FramePacer
+{
+public:
+
+    struct Statistics
+    {
+        int _frames;
+        int _missedDeadlines;       // frames that started later than deadline + tolerance
+        int64_t _maxLateness_nsec;
+        double _meanLateness_nsec;
+        double _meanInterval_nsec;
+        double _intervalDeviation_nsec;
+    };
+
+private:
+
+    static const int64_t MISS_TOLERANCE_NSEC = 1000000;
+    static constexpr float MAX_WAIT_MS = 1000.f;   // for a frame, also when nothing is due
+
+    int64_t _period_nsec;           // 0 means no frame rate limit
+    int64_t _spin_nsec;
+    int64_t _frameStart_nsec;
+    int64_t _deadline_nsec;
+
+    int _frames;
+    int _missedDeadlines;
+    int64_t _maxLateness_nsec;
+    double _latenessSum_nsec;
+    double _intervalSum_nsec;
+    double _intervalSquaresSum_nsec;
+
+    static void SleepUntil (int64_t deadline_nsec)
+    {
+        struct timespec deadline = {};
+        deadline.tv_sec  = deadline_nsec / 1000000000LL;
+        deadline.tv_nsec = deadline_nsec % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+            ;
+    }
+
+public:
+
+    FramePacer (float targetRate = 0.f, float spin_sec = 0.f):
+        _period_nsec (targetRate > 0 ? (int64_t)(1e9 / targetRate) : 0),
+        _spin_nsec ((int64_t)(spin_sec * 1e9)),
+        _frameStart_nsec (GetMonotonicTime_nsec()),
+        _deadline_nsec (_frameStart_nsec),
+        _frames (0),
+        _missedDeadlines (0),
+        _maxLateness_nsec (0),
+        _latenessSum_nsec (0),
+        _intervalSum_nsec (0),
+        _intervalSquaresSum_nsec (0)
+    {}
+
+    void SetTargetRate (float framesPerSecond)
+    {
+        _period_nsec = framesPerSecond > 0 ? (int64_t)(1e9 / framesPerSecond) : 0;
+    }
+
+    void SetSpin (float spin_sec)
+    {
+        _spin_nsec = (int64_t)(spin_sec * 1e9);
+    }
+
+    // timeToNext_ms is counted from the start of the previous frame, as SystemManager::Update returns it.
+    // With a target rate, frames are also never closer than one period. INFINITY, as when every
+    // system is dormant, waits MAX_WAIT_MS
+    void WaitNextFrame (float timeToNext_ms)
+    {
+        if (!(timeToNext_ms >= 0.f))                // NaN too
+            timeToNext_ms = 0.f;
+        else if (timeToNext_ms > MAX_WAIT_MS)
+            timeToNext_ms = MAX_WAIT_MS;
+        int64_t requested_nsec = _frameStart_nsec + (int64_t)(timeToNext_ms * 1e6);
+
+        int64_t deadline_nsec = requested_nsec;
+        if (_period_nsec > 0)
+        {
+            int64_t onRate_nsec = _deadline_nsec + _period_nsec;
+            if (onRate_nsec + _period_nsec < _frameStart_nsec)
+                onRate_nsec = _frameStart_nsec;         // too far behind: don't burst to catch up
+            if (deadline_nsec < onRate_nsec)
+                deadline_nsec = onRate_nsec;
+        }
+
+        if (deadline_nsec - _spin_nsec > GetMonotonicTime_nsec())
+            SleepUntil(deadline_nsec - _spin_nsec);
+
+        int64_t now_nsec = GetMonotonicTime_nsec();
+        while (now_nsec < deadline_nsec)
+            now_nsec = GetMonotonicTime_nsec();
+
+        int64_t lateness_nsec = now_nsec - deadline_nsec;
+        if (lateness_nsec > MISS_TOLERANCE_NSEC)
+            _missedDeadlines++;
+        if (lateness_nsec > _maxLateness_nsec)
+            _maxLateness_nsec = lateness_nsec;
+        _latenessSum_nsec += lateness_nsec;
+
+        double interval_nsec = now_nsec - _frameStart_nsec;
+        _intervalSum_nsec += interval_nsec;
+        _intervalSquaresSum_nsec += interval_nsec * interval_nsec;
+        _frames++;
+
+        _deadline_nsec = deadline_nsec;
+        _frameStart_nsec = now_nsec;
+    }
+
+    Statistics GetStatistics() const
+    {
+        Statistics statistics = {};
+        statistics._frames = _frames;
+        statistics._missedDeadlines = _missedDeadlines;
+        statistics._maxLateness_nsec = _maxLateness_nsec;
+        if (_frames > 0)
+        {
+            statistics._meanLateness_nsec = _latenessSum_nsec / _frames;
+            statistics._meanInterval_nsec = _intervalSum_nsec / _frames;
+            double variance = _intervalSquaresSum_nsec / _frames - statistics._meanInterval_nsec * statistics._meanInterval_nsec;
+            statistics._intervalDeviation_nsec = variance > 0 ? sqrt(variance) : 0;
+        }
+        return statistics;
+    }
+
+    void PrintStatistics (FILE* stream) const
+    {
+        Statistics statistics = GetStatistics();
+        fprintf(stream, "frames: %d, missed deadlines: %d, lateness: mean %.3f ms, max %.3f ms, "
+                        "frame interval: mean %.3f ms, deviation %.3f ms\n",
+                statistics._frames, statistics._missedDeadlines,
+                statistics._meanLateness_nsec / 1e6, statistics._maxLateness_nsec / 1e6,
+                statistics._meanInterval_nsec / 1e6, statistics._intervalDeviation_nsec / 1e6);
+    }
+
+};
+
+#endif // ! __FRAME_PACER_H__
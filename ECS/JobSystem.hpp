@@ -0,0 +1,396 @@
+#pragma once
+#ifndef __JOB_SYSTEM_H__
+#define __JOB_SYSTEM_H__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <vector>
+
+class Job;
+typedef std::shared_ptr<Job> JobPtr;
+
+class Job: public std::enable_shared_from_this<Job>
+{
+    friend class JobSystem;
+
+    std::function<void()> _task;
+    JobPtr _parent;
+    bool _mainThread;
+    World* _world;                      // the task runs bound to the world that created the job
+
+    std::atomic<int> _unfinished;       // this job and its children
+    std::atomic<int> _dependencies;     // unfinished ancestors + 1 until Run() is called
+    std::atomic<int> _waiters;          // threads asleep in JobSystem::Wait() for it
+
+    std::mutex _continuationsMutex;
+    std::vector<JobPtr> _continuations;
+    bool _finished;
+
+public:
+
+    Job (std::function<void()> task, JobPtr parent, bool mainThread):
+        _task (std::move(task)),
+        _parent (std::move(parent)),
+        _mainThread (mainThread),
+        _world (&World::GetCurrent()),
+        _unfinished (1),
+        _dependencies (1),
+        _waiters (0),
+        _finished (false)
+    {}
+
+    inline bool IsFinished() const
+    {
+        return _unfinished.load() == 0;
+    }
+};
+
+// Each thread owns a deque: the owner pushes and pops at the back, idle threads steal
+// from the front of someone else's deque. The thread that called Start() is worker 0
+// and the only one that executes jobs bound to the main thread
+class JobSystem
+{
+    struct Worker
+    {
+        std::mutex _mutex;
+        std::deque<JobPtr> _jobs;
+    };
+
+    static const int MIN_GRAIN = 64;
+    static const int CHUNKS_PER_THREAD = 8;
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    Worker _mainThreadJobs;
+
+    std::atomic<int> _queuedJobs;      // only the ones any thread can take
+    std::atomic<int> _queuedMainThreadJobs;
+    std::atomic<bool> _stopping;
+    std::mutex _sleepMutex;
+    std::condition_variable _hasJobs;
+
+    static thread_local int _workerIndex;
+    static thread_local Job* _currentJob;
+
+    void Push (JobPtr job)
+    {
+        if (job->_mainThread)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mainThreadJobs._mutex);
+                _mainThreadJobs._jobs.push_back(std::move(job));
+            }
+            _queuedMainThreadJobs++;
+        }
+        else
+        {
+            Worker& worker = *_workers[_workerIndex < 0 ? 0 : _workerIndex];
+            {
+                std::lock_guard<std::mutex> lock(worker._mutex);
+                worker._jobs.push_back(std::move(job));
+            }
+            _queuedJobs++;
+        }
+
+        // wakes the sleeping workers, and the main thread if it waits
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+        }
+        _hasJobs.notify_all();
+    }
+
+    JobPtr PopBack (Worker& worker)
+    {
+        std::lock_guard<std::mutex> lock(worker._mutex);
+        if (worker._jobs.empty())
+            return nullptr;
+        JobPtr job = std::move(worker._jobs.back());
+        worker._jobs.pop_back();
+        _queuedJobs--;
+        return job;
+    }
+
+    JobPtr StealFront (Worker& worker)
+    {
+        std::lock_guard<std::mutex> lock(worker._mutex);
+        if (worker._jobs.empty())
+            return nullptr;
+        JobPtr job = std::move(worker._jobs.front());
+        worker._jobs.pop_front();
+        _queuedJobs--;
+        return job;
+    }
+
+    JobPtr FindJob()
+    {
+        int self = _workerIndex < 0 ? 0 : _workerIndex;
+        JobPtr job = PopBack(*_workers[self]);
+        if (job)
+            return job;
+
+        if (_workerIndex == 0)
+        {
+            std::lock_guard<std::mutex> lock(_mainThreadJobs._mutex);
+            if (!_mainThreadJobs._jobs.empty())
+            {
+                job = std::move(_mainThreadJobs._jobs.front());
+                _mainThreadJobs._jobs.pop_front();
+                _queuedMainThreadJobs--;
+                return job;
+            }
+        }
+
+        int workersCount = (int)_workers.size();
+        for (int i = 1; i < workersCount; i++)
+        {
+            job = StealFront(*_workers[(self + i) % workersCount]);
+            if (job)
+                return job;
+        }
+
+        return nullptr;
+    }
+
+    void Execute (const JobPtr& job)
+    {
+        Job* outerJob = _currentJob;
+        _currentJob = job.get();
+        {
+            World::Scope scope (*job->_world);
+            job->_task();
+        }
+        _currentJob = outerJob;
+
+        Finish(job.get());
+    }
+
+    void Finish (Job* job)
+    {
+        if (--job->_unfinished > 0)
+            return;
+
+        std::vector<JobPtr> continuations;
+        {
+            std::lock_guard<std::mutex> lock(job->_continuationsMutex);
+            job->_finished = true;
+            continuations.swap(job->_continuations);
+        }
+
+        if (job->_waiters > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_sleepMutex);
+            }
+            _hasJobs.notify_all();
+        }
+
+        for (JobPtr& continuation : continuations)
+            if (--continuation->_dependencies == 0)
+                Push(std::move(continuation));
+
+        if (job->_parent)
+            Finish(job->_parent.get());
+    }
+
+    void WorkerLoop (int workerIndex)
+    {
+        _workerIndex = workerIndex;
+        while (!_stopping)
+        {
+            JobPtr job = FindJob();
+            if (job)
+            {
+                Execute(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            _hasJobs.wait(lock, [this] { return _stopping || _queuedJobs > 0; });
+        }
+    }
+
+    template <typename Function>
+    void RunRange (int begin, int end, int grain, const Function& function)
+    {
+        // Keep halving the range: the halves left in our deque are what idle threads steal
+        while (end - begin > grain)
+        {
+            int middle = begin + (end - begin) / 2;
+            Run(CreateJob([this, middle, end, grain, &function] { RunRange(middle, end, grain, function); }));
+            end = middle;
+        }
+
+        for (int i = begin; i < end; i++)
+            function(i);
+    }
+
+    // pools: the entities vectors of ComponentNames, looked up once for the whole range
+    template <typename... ComponentNames, typename Function, typename... Pools>
+    void ParallelForEachIn (Function& function, int grain, const Pools&... pools)
+    {
+        size_t sizes[] = { pools.size()... };
+        size_t size = sizes[0];
+        for (size_t poolSize : sizes)
+            if (poolSize < size)
+                size = poolSize;
+
+        ParallelFor(0, (int)size, [&function, &pools...] (int entityId)
+        {
+            if (((pools[entityId] != nullptr) && ...))
+                function(*static_cast<ComponentNames*>(pools[entityId])...);
+        }, grain);
+    }
+
+public:
+
+    JobSystem():
+        _queuedJobs (0),
+        _queuedMainThreadJobs (0),
+        _stopping (false)
+    {
+        _workers.emplace_back(new Worker());
+    }
+
+    ~JobSystem()
+    {
+        Stop();
+    }
+
+    // threadsCount includes the calling thread, so 1 means no extra threads
+    void Start (int threadsCount)
+    {
+        Stop();
+        if (threadsCount < 1)
+            threadsCount = 1;
+
+        _stopping = false;
+        _workerIndex = 0;
+        _workers.clear();
+        for (int i = 0; i < threadsCount; i++)
+            _workers.emplace_back(new Worker());
+        for (int i = 1; i < threadsCount; i++)
+            _threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+
+        _LOG("JobSystem: started %d thread(s)\n", threadsCount);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+            _stopping = true;
+        }
+        _hasJobs.notify_all();
+        for (std::thread& thread : _threads)
+            thread.join();
+        _threads.clear();
+    }
+
+    inline int GetThreadsCount() const
+    {
+        return (int)_workers.size();
+    }
+
+    // -1 for threads that don't belong to the job system
+    inline int GetWorkerIndex() const
+    {
+        return _workerIndex;
+    }
+
+    // Children of a job keep it unfinished; by default the job being executed is the parent
+    JobPtr CreateJob (std::function<void()> task, bool mainThread = false)
+    {
+        JobPtr parent;
+        if (_currentJob)
+            parent = _currentJob->shared_from_this();
+        return CreateJob(std::move(task), parent, mainThread);
+    }
+
+    JobPtr CreateJob (std::function<void()> task, JobPtr parent, bool mainThread = false)
+    {
+        if (parent)
+            parent->_unfinished++;
+        return std::make_shared<Job>(std::move(task), std::move(parent), mainThread);
+    }
+
+    // continuation starts only after ancestor is finished. Must be called before Run(continuation)
+    void Then (const JobPtr& ancestor, const JobPtr& continuation)
+    {
+        std::lock_guard<std::mutex> lock(ancestor->_continuationsMutex);
+        if (ancestor->_finished)
+            return;
+        continuation->_dependencies++;
+        ancestor->_continuations.push_back(continuation);
+    }
+
+    void Run (const JobPtr& job)
+    {
+        if (--job->_dependencies == 0)
+            Push(job);
+    }
+
+    // The waiting thread executes other jobs meanwhile, and sleeps when there are none
+    void Wait (const JobPtr& job)
+    {
+        while (!job->IsFinished())
+        {
+            JobPtr other = FindJob();
+            if (other)
+            {
+                Execute(other);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            job->_waiters++;
+            _hasJobs.wait(lock, [this, &job]
+            {
+                return job->IsFinished() || _queuedJobs > 0 || (_workerIndex == 0 && _queuedMainThreadJobs > 0);
+            });
+            job->_waiters--;
+        }
+    }
+
+    template <typename Function>
+    void ParallelFor (int begin, int end, Function function, int grain = 0)
+    {
+        if (end <= begin)
+            return;
+
+        if (GetThreadsCount() == 1)
+        {
+            for (int i = begin; i < end; i++)
+                function(i);
+            return;
+        }
+
+        if (grain <= 0)
+            grain = (end - begin) / (GetThreadsCount() * CHUNKS_PER_THREAD);
+        if (grain < MIN_GRAIN)
+            grain = MIN_GRAIN;
+
+        JobPtr range = CreateJob([this, begin, end, grain, &function] { RunRange(begin, end, grain, function); }, JobPtr());
+        Run(range);
+        Wait(range);
+    }
+
+    // Calls function(ComponentNames&...) for every entity of components that has all of ComponentNames
+    template <typename... ComponentNames, typename Function>
+    void ParallelForEach (const ComponentManager& components, Function function, int grain = 0)
+    {
+        ParallelForEachIn<ComponentNames...>(function, grain, components.GetEntitiesVector<ComponentNames>()...);
+    }
+
+};
+
+thread_local int JobSystem::_workerIndex = -1;
+thread_local Job* JobSystem::_currentJob = nullptr;
+
+JobSystem jobSystem;
+
+#endif // ! __JOB_SYSTEM_H__
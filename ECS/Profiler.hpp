@@ -0,0 +1,258 @@
+#pragma once
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+// Scoped timing zones, compiled in only with PROFILING defined:
+//     PROFILE_ZONE(name, category)   times the rest of the enclosing scope
+//     PROFILE_INSTANT(name, category) marks a moment, e.g. a change of state
+//     PROFILE_COUNTER(name, value)   a value tracked over time, shown as a graph in the trace
+//     PROFILE_FRAME()                starts a new frame
+//     PROFILE_EXPORT_TRACE(file)     writes zones as Chrome trace JSON (about://tracing, Perfetto)
+//     PROFILE_PRINT_SUMMARY(stream)  writes p50/p95/p99 of every zone name over the frames it ran in
+// name and category must be strings with static storage duration.
+
+#ifdef PROFILING
+
+#include <cstdio>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+
+class Profiler
+{
+public:
+
+    enum ZoneType
+    {
+        DURATION,
+        INSTANT,
+        COUNTER
+    };
+
+    struct Zone
+    {
+        const char* _name;
+        const char* _category;
+        int64_t _start_nsec;
+        int64_t _end_nsec;
+        int _frame;
+        ZoneType _type;
+        int64_t _value;             // of a counter
+    };
+
+private:
+
+    static const int BUFFER_CAPACITY = 1 << 16;     // zones per thread, older ones are overwritten
+
+    // Written only by its thread; readers see zones [max(0, head - capacity), head)
+    struct ThreadBuffer
+    {
+        Zone _zones[BUFFER_CAPACITY];
+        std::atomic<uint64_t> _head;
+        int _threadIndex;               // in the order threads record their first zones
+        std::atomic<bool> _isMain;      // the thread starts frames
+
+        ThreadBuffer (int threadIndex):
+            _head (0),
+            _threadIndex (threadIndex),
+            _isMain (false)
+        {}
+    };
+
+    std::mutex _buffersMutex;       // taken by the first zone of a thread and by exporting, not by recording
+    std::vector<std::unique_ptr<ThreadBuffer>> _buffers;
+    std::atomic<int> _frame;
+    int64_t _startTime_nsec;
+
+    static thread_local ThreadBuffer* _threadBuffer;
+
+    ThreadBuffer* GetThreadBuffer()
+    {
+        if (_threadBuffer == nullptr)
+        {
+            std::lock_guard<std::mutex> lock(_buffersMutex);
+            _buffers.emplace_back(new ThreadBuffer((int)_buffers.size()));
+            _threadBuffer = _buffers.back().get();
+        }
+        return _threadBuffer;
+    }
+
+    std::vector<Zone> CollectZones()
+    {
+        std::vector<Zone> zones;
+        std::lock_guard<std::mutex> lock(_buffersMutex);
+        for (auto& buffer : _buffers)
+        {
+            uint64_t head = buffer->_head.load(std::memory_order_acquire);
+            uint64_t begin = head > BUFFER_CAPACITY ? head - BUFFER_CAPACITY : 0;
+            for (uint64_t i = begin; i < head; i++)
+                zones.push_back(buffer->_zones[i % BUFFER_CAPACITY]);
+        }
+        return zones;
+    }
+
+    static double Percentile (std::vector<double>& sorted, int percent)
+    {
+        int rank = (int)((percent * sorted.size() + 99) / 100);
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+
+public:
+
+    Profiler():
+        _frame (0),
+        _startTime_nsec (GetMonotonicTime_nsec())
+    {}
+
+    inline void Record (const char* name, const char* category, int64_t start_nsec, int64_t end_nsec,
+                        ZoneType type = DURATION, int64_t value = 0)
+    {
+        ThreadBuffer* buffer = GetThreadBuffer();
+        uint64_t head = buffer->_head.load(std::memory_order_relaxed);
+        buffer->_zones[head % BUFFER_CAPACITY] = { name, category, start_nsec, end_nsec, _frame.load(std::memory_order_relaxed), type, value };
+        buffer->_head.store(head + 1, std::memory_order_release);
+    }
+
+    inline void RecordInstant (const char* name, const char* category)
+    {
+        int64_t now_nsec = GetMonotonicTime_nsec();
+        Record(name, category, now_nsec, now_nsec, INSTANT);
+    }
+
+    inline void RecordCounter (const char* name, int64_t value)
+    {
+        int64_t now_nsec = GetMonotonicTime_nsec();
+        Record(name, "counter", now_nsec, now_nsec, COUNTER, value);
+    }
+
+    // From the main thread; it is labelled main in the trace, whichever thread recorded first
+    inline void NextFrame()
+    {
+        GetThreadBuffer()->_isMain.store(true, std::memory_order_relaxed);
+        _frame++;
+    }
+
+    bool ExportChromeTrace (const char* filename)
+    {
+        FILE* trace = fopen(filename, "w");
+        if (!trace)
+        {
+            _LOG("ERROR: Profiler can't open %s\n", filename);
+            return false;
+        }
+
+        fprintf(trace, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+
+        std::lock_guard<std::mutex> lock(_buffersMutex);
+        for (auto& buffer : _buffers)
+        {
+            fprintf(trace, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                    first ? "" : ",\n", buffer->_threadIndex, buffer->_isMain.load(std::memory_order_relaxed) ? "main" : "worker", buffer->_threadIndex);
+            first = false;
+
+            uint64_t head = buffer->_head.load(std::memory_order_acquire);
+            uint64_t begin = head > BUFFER_CAPACITY ? head - BUFFER_CAPACITY : 0;
+            for (uint64_t i = begin; i < head; i++)
+            {
+                const Zone& zone = buffer->_zones[i % BUFFER_CAPACITY];
+                if (zone._type == INSTANT)
+                    fprintf(trace, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"frame\":%d}}",
+                            zone._name, zone._category, (zone._start_nsec - _startTime_nsec) / 1e3, buffer->_threadIndex, zone._frame);
+                else if (zone._type == COUNTER)
+                    fprintf(trace, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"value\":%lld}}",
+                            zone._name, (zone._start_nsec - _startTime_nsec) / 1e3, (long long)zone._value);
+                else
+                    fprintf(trace, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"frame\":%d}}",
+                            zone._name, zone._category, (zone._start_nsec - _startTime_nsec) / 1e3,
+                            (zone._end_nsec - zone._start_nsec) / 1e3, buffer->_threadIndex, zone._frame);
+            }
+        }
+
+        fprintf(trace, "\n]}\n");
+        fclose(trace);
+        return true;
+    }
+
+    // Time spent in every zone name per frame (zones of the same name in one frame are summed)
+    void PrintSummary (FILE* stream)
+    {
+        std::vector<Zone> zones = CollectZones();
+
+        std::map<std::string, std::map<int, double>> perFrame_ms;
+        std::map<std::string, int> instants;
+        for (const Zone& zone : zones)
+            if (zone._type == INSTANT)
+                instants[std::string(zone._category) + " " + zone._name]++;
+            else if (zone._type == DURATION)
+                perFrame_ms[std::string(zone._category) + " " + zone._name][zone._frame] += (zone._end_nsec - zone._start_nsec) / 1e6;
+
+        fprintf(stream, "%-48s %8s %10s %10s %10s %10s\n", "zone", "frames", "p50, ms", "p95, ms", "p99, ms", "max, ms");
+        for (auto& zone : perFrame_ms)
+        {
+            std::vector<double> durations;
+            for (auto& frame : zone.second)
+                durations.push_back(frame.second);
+            std::sort(durations.begin(), durations.end());
+
+            fprintf(stream, "%-48s %8d %10.3f %10.3f %10.3f %10.3f\n", zone.first.c_str(), (int)durations.size(),
+                    Percentile(durations, 50), Percentile(durations, 95), Percentile(durations, 99), durations.back());
+        }
+
+        if (!instants.empty())
+            fprintf(stream, "\n%-48s %8s\n", "instant", "count");
+        for (auto& instant : instants)
+            fprintf(stream, "%-48s %8d\n", instant.first.c_str(), instant.second);
+    }
+
+};
+
+thread_local Profiler::ThreadBuffer* Profiler::_threadBuffer = nullptr;
+
+Profiler profiler;
+
+class ProfileZone
+{
+    const char* _name;
+    const char* _category;
+    int64_t _start_nsec;
+
+public:
+
+    ProfileZone (const char* name, const char* category):
+        _name (name),
+        _category (category),
+        _start_nsec (GetMonotonicTime_nsec())
+    {}
+
+    ~ProfileZone()
+    {
+        profiler.Record(_name, _category, _start_nsec, GetMonotonicTime_nsec());
+    }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name, category) ProfileZone PROFILE_CONCAT(profileZone_, __LINE__) (name, category);
+#define PROFILE_INSTANT(name, category) profiler.RecordInstant(name, category);
+#define PROFILE_COUNTER(name, value) profiler.RecordCounter(name, value);
+#define PROFILE_FRAME() profiler.NextFrame();
+#define PROFILE_EXPORT_TRACE(filename) profiler.ExportChromeTrace(filename);
+#define PROFILE_PRINT_SUMMARY(stream) profiler.PrintSummary(stream);
+
+#else
+
+#define PROFILE_ZONE(name, category) ;
+#define PROFILE_INSTANT(name, category) ;
+#define PROFILE_COUNTER(name, value) ;
+#define PROFILE_FRAME() ;
+#define PROFILE_EXPORT_TRACE(filename) ;
+#define PROFILE_PRINT_SUMMARY(stream) ;
+
+#endif // PROFILING
+
+#endif // ! __PROFILER_H__
@@ -0,0 +1,245 @@
+#pragma once
+#ifndef __SPATIAL_GRID_H__
+#define __SPATIAL_GRID_H__
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Entity positions bucketed into square cells, hashed by cell coordinates so the world
+// needs no bounds. The game keeps it up to date: Insert() when an entity gets a position,
+// Move() when it moves, Remove() when it loses it. Move() only touches the buckets when
+// the entity leaves its cell. Queries visit the cells that overlap the region, so their
+// cost follows the size of the region, not the number of entities in the world.
+// Positions are kept as a cell and an offset in it, so shifting everything by whole cells
+// only changes which cell coordinates count from: it takes no time and loses no precision.
+// Guarded like the positions it indexes: systems that query it read them, systems that
+// change it write them
+class SpatialGrid
+{
+    struct Entry
+    {
+        int _cellX;                     // in the grid's cells, which are _shiftX, _shiftY away from the coordinates'
+        int _cellY;
+        float _offsetX;                 // from the corner of the cell
+        float _offsetY;
+        int _slot;                      // in the bucket of the cell, -1 if the entity isn't indexed
+    };
+
+    float _cellSize;
+    int _shiftX;
+    int _shiftY;
+    std::unordered_map<int64_t, std::vector<entity_id_t>> _cells;
+    std::vector<Entry> _entries;        // [entityId]
+    int _count;
+
+    inline int CellOf (float coordinate) const
+    {
+        return (int)std::floor(coordinate / _cellSize);
+    }
+
+    static inline int64_t CellKey (int cellX, int cellY)
+    {
+        return ((int64_t)cellX << 32) | (uint32_t)cellY;
+    }
+
+    inline void Place (Entry& entry, float x, float y) const
+    {
+        int cellX = CellOf(x), cellY = CellOf(y);
+        entry._cellX = cellX + _shiftX;
+        entry._cellY = cellY + _shiftY;
+        entry._offsetX = x - (float)cellX * _cellSize;
+        entry._offsetY = y - (float)cellY * _cellSize;
+    }
+
+    inline float GetX (const Entry& entry) const
+    {
+        return (float)(entry._cellX - _shiftX) * _cellSize + entry._offsetX;
+    }
+
+    inline float GetY (const Entry& entry) const
+    {
+        return (float)(entry._cellY - _shiftY) * _cellSize + entry._offsetY;
+    }
+
+    void AddToCell (entity_id_t entityId, Entry& entry)
+    {
+        std::vector<entity_id_t>& bucket = _cells[CellKey(entry._cellX, entry._cellY)];
+        entry._slot = (int)bucket.size();
+        bucket.push_back(entityId);
+    }
+
+    void RemoveFromCell (Entry& entry)
+    {
+        auto cell = _cells.find(CellKey(entry._cellX, entry._cellY));
+        std::vector<entity_id_t>& bucket = cell->second;
+        entity_id_t last = bucket.back();
+        bucket[entry._slot] = last;
+        _entries[last]._slot = entry._slot;
+        bucket.pop_back();
+        if (bucket.empty())
+            _cells.erase(cell);
+        entry._slot = -1;
+    }
+
+    // Places every entity anew, cellSize wide cells, moved by dx, dy
+    void Rebuild (float cellSize, float dx, float dy)
+    {
+        std::vector<std::pair<float, float>> positions (_entries.size());
+        for (int entityId = 0; entityId < (int)_entries.size(); entityId++)
+            positions[entityId] = { GetX(_entries[entityId]) + dx, GetY(_entries[entityId]) + dy };
+
+        _cellSize = cellSize;
+        _shiftX = 0;
+        _shiftY = 0;
+        _cells.clear();
+        for (entity_id_t entityId = 0; entityId < (entity_id_t)_entries.size(); entityId++)
+        {
+            Entry& entry = _entries[entityId];
+            if (entry._slot == -1)
+                continue;
+            Place(entry, positions[entityId].first, positions[entityId].second);
+            AddToCell(entityId, entry);
+        }
+    }
+
+    template <typename Function>
+    void ForEachInCells (float minX, float minY, float maxX, float maxY, Function function) const
+    {
+        // a region wider than the populated part of the world, unbounded ones too: cheaper to walk the buckets
+        double cellsCount = (std::floor((double)maxX / _cellSize) - std::floor((double)minX / _cellSize) + 1)
+                          * (std::floor((double)maxY / _cellSize) - std::floor((double)minY / _cellSize) + 1);
+        if (!(cellsCount <= (double)_cells.size()))
+        {
+            for (const auto& cell : _cells)
+                for (entity_id_t entityId : cell.second)
+                    function(entityId, GetX(_entries[entityId]), GetY(_entries[entityId]));
+            return;
+        }
+
+        int minCellX = CellOf(minX) + _shiftX, maxCellX = CellOf(maxX) + _shiftX,
+            minCellY = CellOf(minY) + _shiftY, maxCellY = CellOf(maxY) + _shiftY;
+
+        for (int cellX = minCellX; cellX <= maxCellX; cellX++)
+            for (int cellY = minCellY; cellY <= maxCellY; cellY++)
+            {
+                auto cell = _cells.find(CellKey(cellX, cellY));
+                if (cell == _cells.end())
+                    continue;
+                for (entity_id_t entityId : cell->second)
+                    function(entityId, GetX(_entries[entityId]), GetY(_entries[entityId]));
+            }
+    }
+
+public:
+
+    SpatialGrid (float cellSize = 256.f):
+        _cellSize (cellSize),
+        _shiftX (0),
+        _shiftY (0),
+        _count (0)
+    {}
+
+    void SetCellSize (float cellSize)
+    {
+        Rebuild(cellSize, 0.f, 0.f);
+    }
+
+    inline float GetCellSize() const
+    {
+        return _cellSize;
+    }
+
+    inline int GetCount() const
+    {
+        return _count;
+    }
+
+    void Insert (entity_id_t entityId, float x, float y)
+    {
+        if (entityId >= (entity_id_t)_entries.size())
+            _entries.resize(entityId + 1, Entry { 0, 0, 0.f, 0.f, -1 });
+
+        Entry& entry = _entries[entityId];
+        if (entry._slot != -1)
+        {
+            Move(entityId, x, y);
+            return;
+        }
+        Place(entry, x, y);
+        AddToCell(entityId, entry);
+        _count++;
+    }
+
+    void Move (entity_id_t entityId, float x, float y)
+    {
+        if (entityId >= (entity_id_t)_entries.size() || _entries[entityId]._slot == -1)
+        {
+            Insert(entityId, x, y);
+            return;
+        }
+
+        Entry& entry = _entries[entityId];
+        Entry moved = entry;
+        Place(moved, x, y);
+        if (moved._cellX == entry._cellX && moved._cellY == entry._cellY)
+        {
+            entry._offsetX = moved._offsetX;
+            entry._offsetY = moved._offsetY;
+            return;
+        }
+        RemoveFromCell(entry);
+        moved._slot = -1;
+        entry = moved;
+        AddToCell(entityId, entry);
+    }
+
+    void Remove (entity_id_t entityId)
+    {
+        if (entityId >= (entity_id_t)_entries.size() || _entries[entityId]._slot == -1)
+            return;
+        RemoveFromCell(_entries[entityId]);
+        _count--;
+    }
+
+    // Moves every entity at once, as when the world's origin moves. By whole cells it takes
+    // no time, otherwise every entity is placed anew
+    void Shift (float dx, float dy)
+    {
+        float cellsX = dx / _cellSize, cellsY = dy / _cellSize;
+        if (cellsX == std::floor(cellsX) && cellsY == std::floor(cellsY))
+        {
+            _shiftX -= (int)cellsX;
+            _shiftY -= (int)cellsY;
+            return;
+        }
+        Rebuild(_cellSize, dx, dy);
+    }
+
+    // Appends entities with minX <= x <= maxX and minY <= y <= maxY, in no particular order
+    void QueryAABB (float minX, float minY, float maxX, float maxY, std::vector<entity_id_t>& result) const
+    {
+        ForEachInCells(minX, minY, maxX, maxY, [&] (entity_id_t entityId, float x, float y)
+        {
+            if (x >= minX && x <= maxX && y >= minY && y <= maxY)
+                result.push_back(entityId);
+        });
+    }
+
+    // Appends entities not farther than radius from (x, y), in no particular order
+    void QueryRadius (float x, float y, float radius, std::vector<entity_id_t>& result) const
+    {
+        float radiusSquared = radius * radius;
+        ForEachInCells(x - radius, y - radius, x + radius, y + radius, [&] (entity_id_t entityId, float entryX, float entryY)
+        {
+            float dx = entryX - x, dy = entryY - y;
+            if (dx * dx + dy * dy <= radiusSquared)
+                result.push_back(entityId);
+        });
+    }
+
+};
+
+#endif // ! __SPATIAL_GRID_H__
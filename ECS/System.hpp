@@ -3,6 +3,66 @@
 #define __SYSTEM_H__
 
 #include <cassert>
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <queue>
+#include <mutex>
+#include <climits>
+
+// What a system touches during Update(). Two systems that conflict are never run
+// concurrently, and the one with higher priority is updated first
+struct SystemAccess
+{
+    std::vector<component_t_id_t> _readsComponents;
+    std::vector<component_t_id_t> _writesComponents;
+    std::vector<id_t> _receivesEvents;
+    std::vector<id_t> _sendsEvents;
+    bool _declared;         // system without declaration conflicts with everyone
+    bool _structural;       // creates or destroys entities
+    bool _mainThread;       // must be updated on the thread that owns the window
+
+    // Not access, but when the system has work: with _eventDriven it's dormant while no
+    // events are raised for it; a dormant system is also woken up when components of
+    // _watchesComponents types are added or removed
+    bool _eventDriven;
+    std::vector<component_t_id_t> _watchesComponents;
+
+    SystemAccess():
+        _declared (false),
+        _structural (false),
+        _mainThread (false),
+        _eventDriven (false)
+    {}
+
+    template <typename T>
+    static bool Intersect (const std::vector<T>& lhs, const std::vector<T>& rhs)
+    {
+        for (const T& item : lhs)
+            if (std::find(rhs.begin(), rhs.end(), item) != rhs.end())
+                return true;
+        return false;
+    }
+
+    bool ConflictsWith (const SystemAccess& rhs) const
+    {
+        if (!this->_declared || !rhs._declared)
+            return true;
+
+        if (this->_structural && rhs._structural)
+            return true;
+
+        if (Intersect(this->_writesComponents, rhs._writesComponents)
+         || Intersect(this->_writesComponents, rhs._readsComponents)
+         || Intersect(this->_readsComponents,  rhs._writesComponents))
+            return true;
+
+        // sending pushes to _raisedEvents of every receiver
+        return Intersect(this->_sendsEvents, rhs._sendsEvents)
+            || Intersect(this->_sendsEvents, rhs._receivesEvents)
+            || Intersect(this->_receivesEvents, rhs._sendsEvents);
+    }
+};
 
 class ISystem
 {
@@ -10,14 +70,83 @@ class ISystem
     //int _updateRound;
 
 public:
+    // What to do when a system is late for more than one _updateInterval
+    enum OverrunPolicy
+    {
+        SKIP_MISSED,        // update once, next update on the original schedule
+        CATCH_UP            // repeat updates until schedule is met (bounded)
+    };
+
     int _priority;
     float _updateInterval;
+    SystemAccess _access;
+
+    OverrunPolicy _overrunPolicy;
+    int64_t _nextUpdate_nsec;       // -1 until the system is scheduled, DORMANT till it's woken up
+    int _updatesCount;
+    int _skippedUpdates;
+
+    bool _fixedStep;                // updated exactly every _updateInterval of world time, see SystemManager::SetFixedStep
+    int64_t _stepTime_nsec;         // time the current (or the last) update was due at
+
+    int _itemsBudget;               // of the work it may spread over frames, per update, see SystemManager::SetBudget
+    float _timeBudget_ms;
+    int _workLeft;                  // items of such work it left for the next updates
+
+    IEventListener* _listener;      // this system as a listener, nullptr if it isn't one
+    uint64_t _watchedVersion;       // of _access._watchesComponents when the system fell dormant
+
+    World* _world;                  // the one whose SystemManager owns the system
+
+    // the parts of _world
+    WorldClock& _worldClock;
+    ComponentManager& _componentManager;
+    EntityManager& _entityManager;
+    EventManager& _eventManager;
+    SystemManager& _systemManager;
+    SpatialGrid& _spatialGrid;
+    FloatingOrigin& _worldOrigin;
+    ActivityRegion& _activityRegion;
+
+    ISystem (World& world):
+        _overrunPolicy (SKIP_MISSED),
+        _nextUpdate_nsec (-1),
+        _updatesCount (0),
+        _skippedUpdates (0),
+        _fixedStep (false),
+        _stepTime_nsec (-1),
+        _itemsBudget (0),
+        _timeBudget_ms (0.f),
+        _workLeft (0),
+        _listener (nullptr),
+        _watchedVersion (0),
+        _world (&world),
+        _worldClock (*world._clock),
+        _componentManager (*world._componentManager),
+        _entityManager (*world._entityManager),
+        _eventManager (*world._eventManager),
+        _systemManager (*world._systemManager),
+        _spatialGrid (*world._spatialGrid),
+        _worldOrigin (*world._origin),
+        _activityRegion (*world._activity)
+    {}
+
+    static const int64_t DORMANT = INT64_MAX;
 
     virtual ~ISystem()
     {}
 
+    // Returns ms till the next update it needs (at least _updateInterval),
+    // INFINITY to stay dormant till SystemManager::Wake()
     virtual float Update() = 0;
 
+    virtual const char* GetName() const = 0;
+
+    inline World& GetWorld() const
+    {
+        return *_world;
+    }
+
 };
 
 template <typename SystemName>
@@ -26,6 +155,10 @@ class System : public ISystem
     
 public:
 
+    System (World& world):
+        ISystem (world)
+    {}
+
     virtual ~System()
     {}
 
@@ -33,6 +166,67 @@ public:
 
     virtual float Update() override
     { return NAN; }
+
+    virtual const char* GetName() const override
+    { return TypeName<SystemName>(); }
+
+protected:
+
+    // Access declarations, called from constructor of SystemName
+
+    template <typename... ComponentNames>
+    void Reads()
+    {
+        _access._declared = true;
+        (_access._readsComponents.push_back(Component<ComponentNames>::COMPONENT_TYPE_ID), ...);
+    }
+
+    template <typename... ComponentNames>
+    void Writes()
+    {
+        _access._declared = true;
+        (_access._writesComponents.push_back(Component<ComponentNames>::COMPONENT_TYPE_ID), ...);
+    }
+
+    template <typename... EventNames>
+    void Receives()
+    {
+        _access._declared = true;
+        (_access._receivesEvents.push_back(Event<EventNames>::EVENT_TYPE_ID), ...);
+    }
+
+    template <typename... EventNames>
+    void Sends()
+    {
+        _access._declared = true;
+        (_access._sendsEvents.push_back(Event<EventNames>::EVENT_TYPE_ID), ...);
+    }
+
+    // Components of created and destroyed entities must be declared in Writes()
+    void ChangesStructure()
+    {
+        _access._declared = true;
+        _access._structural = true;
+    }
+
+    void RunsOnMainThread()
+    {
+        _access._declared = true;
+        _access._mainThread = true;
+    }
+
+    // Updated only while events for it are pending
+    void EventDriven()
+    {
+        _access._eventDriven = true;
+    }
+
+    // Dormant system is woken up when a component of any of ComponentNames is added or removed
+    template <typename... ComponentNames>
+    void WakesOnChangeOf()
+    {
+        (_access._watchesComponents.push_back(Component<ComponentNames>::COMPONENT_TYPE_ID), ...);
+    }
 };
 
 template <typename SystemName>
@@ -43,7 +237,7 @@ inline int cmp (const ISystem* lhs, const ISystem* key, int oldPriority) // lhs
     if (oldPriority > -1)
         return key == lhs ? lhs->_priority - oldPriority: key->_priority - lhs->_priority;
     int priorDifference = key->_priority - lhs->_priority;
-    return priorDifference != 0 ? priorDifference : (int)(key - lhs);
+    return priorDifference != 0 ? priorDifference : (int)(key > lhs) - (int)(key < lhs);
 }
 
 void binsearch (const ISystem * const * arr, int len, const ISystem* key, bool& found, int& index, int oldPriority /*if not found, key should be inserted on index position*/)
@@ -94,9 +288,181 @@ void binsearch (const ISystem * const * arr, int len, const ISystem* key, bool&
 
 class SystemManager
 {
+    World* _world;
     ISystem** _systemPointers;
     int _systemCount;
-    bool _isRunning;
+    std::atomic<bool> _isRunning;
+
+    // Dependency graph over update rounds: edge i -> j when i < j and systems conflict
+    std::vector<std::vector<int>> _successors;
+    std::vector<int> _predecessorsCount;
+    bool _graphIsDirty;
+
+    std::vector<float> _results;
+
+    void BuildDependencyGraph()
+    {
+        ISystem ** order = systemOrderManager.getSystemOrder();
+        int registered = systemOrderManager.GetRegisteredCount();
+
+        _successors.assign(registered, std::vector<int>());
+        _predecessorsCount.assign(registered, 0);
+
+        for (int i = 0; i < registered; i++)
+            for (int j = i + 1; j < registered; j++)
+                if (order[i]->_access.ConflictsWith(order[j]->_access))
+                {
+                    _successors[i].push_back(j);
+                    _predecessorsCount[j]++;
+                }
+
+        _graphIsDirty = false;
+    }
+
+    // Update rounds ordered by time of their next update. An entry whose time differs
+    // from _nextUpdate_nsec of its system was superseded by Wake() and is skipped
+    typedef std::pair<int64_t, int> ScheduleEntry;
+    std::priority_queue<ScheduleEntry, std::vector<ScheduleEntry>, std::greater<ScheduleEntry>> _schedule;
+    static const int MAX_CATCH_UP_UPDATES = 4;
+
+    std::mutex _wokenMutex;
+    std::vector<ISystem*> _woken;
+
+    void RebuildSchedule (int64_t now_nsec)
+    {
+        ISystem ** order = systemOrderManager.getSystemOrder();
+        int registered = systemOrderManager.GetRegisteredCount();
+
+        _schedule = decltype(_schedule)();
+        for (int i = 0; i < registered; i++)
+        {
+            if (order[i]->_nextUpdate_nsec < 0)
+                order[i]->_nextUpdate_nsec = now_nsec;
+            if (order[i]->_nextUpdate_nsec != ISystem::DORMANT)
+                _schedule.push(ScheduleEntry(order[i]->_nextUpdate_nsec, i));
+        }
+    }
+
+    void ScheduleWoken (int64_t now_nsec)
+    {
+        std::vector<ISystem*> woken;
+        {
+            std::lock_guard<std::mutex> lock(_wokenMutex);
+            woken.swap(_woken);
+        }
+
+        for (ISystem* system : woken)
+            if (system->_nextUpdate_nsec == ISystem::DORMANT)
+                Activate(systemOrderManager.GetUpdateRound(system), now_nsec);
+    }
+
+    void Activate (int updateRound, int64_t now_nsec)
+    {
+        ISystem* system = systemOrderManager.getSystemOrder()[updateRound];
+        PROFILE_INSTANT(system->GetName(), "active")
+        system->_nextUpdate_nsec = now_nsec;
+        _schedule.push(ScheduleEntry(now_nsec, updateRound));
+    }
+
+    // Dormant systems whose watched component types got components added or removed
+    void WakeWatchers (int64_t now_nsec)
+    {
+        ISystem ** order = systemOrderManager.getSystemOrder();
+        int registered = systemOrderManager.GetRegisteredCount();
+
+        for (int i = 0; i < registered; i++)
+            if (order[i]->_nextUpdate_nsec == ISystem::DORMANT && !order[i]->_access._watchesComponents.empty()
+             && _world->_componentManager->GetComponentsVersion(order[i]->_access._watchesComponents) != order[i]->_watchedVersion)
+                Activate(i, now_nsec);
+    }
+
+    void Reschedule (int updateRound, int64_t now_nsec, int catchUps, std::vector<int>& overdue)
+    {
+        ISystem* system = systemOrderManager.getSystemOrder()[updateRound];
+        system->_updatesCount++;
+
+        float interval_ms = _results[updateRound];
+        bool idle = std::isinf(interval_ms)
+                 || (system->_access._eventDriven && system->_listener->_raisedEvents.empty());
+        if (system->_workLeft > 0)
+        {
+            // goes on with its work at its next interval
+            idle = false;
+            interval_ms = 0.f;
+        }
+        if (idle)
+        {
+            // nothing to do till someone calls Wake()
+            PROFILE_INSTANT(system->GetName(), "dormant")
+            system->_nextUpdate_nsec = ISystem::DORMANT;
+            system->_watchedVersion = _world->_componentManager->GetComponentsVersion(system->_access._watchesComponents);
+            return;
+        }
+        if (system->_fixedStep || !(interval_ms >= 1000 * system->_updateInterval))
+            interval_ms = 1000 * system->_updateInterval;
+        int64_t interval_nsec = (int64_t)(interval_ms * 1000000);
+
+        if (interval_nsec <= 0)
+        {
+            // updated on every call
+            system->_nextUpdate_nsec = now_nsec + 1;
+            _schedule.push(ScheduleEntry(system->_nextUpdate_nsec, updateRound));
+            return;
+        }
+
+        system->_nextUpdate_nsec += interval_nsec;
+        if (system->_nextUpdate_nsec <= now_nsec)
+        {
+            if (system->_overrunPolicy == ISystem::CATCH_UP && catchUps < MAX_CATCH_UP_UPDATES)
+            {
+                overdue.push_back(updateRound);
+                return;
+            }
+
+            int64_t missed = (now_nsec - system->_nextUpdate_nsec) / interval_nsec + 1;
+            system->_nextUpdate_nsec += missed * interval_nsec;
+            system->_skippedUpdates += missed;
+        }
+
+        _schedule.push(ScheduleEntry(system->_nextUpdate_nsec, updateRound));
+    }
+
+    void UpdateRound (int updateRound)
+    {
+        ISystem* system = systemOrderManager.getSystemOrder()[updateRound];
+        PROFILE_ZONE(system->GetName(), "system")
+        system->_stepTime_nsec = system->_nextUpdate_nsec;
+        _results[updateRound] = system->Update();
+    }
+
+    void UpdateSerially (const std::vector<int>& updateRounds)
+    {
+        for (int i : updateRounds)
+            UpdateRound(i);
+    }
+
+    void UpdateInParallel (const std::vector<int>& updateRounds)
+    {
+        ISystem ** order = systemOrderManager.getSystemOrder();
+        JobPtr frame = jobSystem.CreateJob([] {}, JobPtr());
+
+        std::vector<JobPtr> jobs (systemOrderManager.GetRegisteredCount());
+        for (int i : updateRounds)
+            jobs[i] = jobSystem.CreateJob([this, i] { UpdateRound(i); },
+                                          frame, order[i]->_access._mainThread);
+
+        for (int i : updateRounds)
+            for (int successor : _successors[i])
+                if (jobs[successor])
+                    jobSystem.Then(jobs[i], jobs[successor]);
+
+        for (int i : updateRounds)
+            jobSystem.Run(jobs[i]);
+
+        jobSystem.Run(frame);
+        jobSystem.Wait(frame);
+    }
+
 public:
     class SystemOrderManager
     {
@@ -220,10 +586,16 @@ public:
             int systemOrderIdx = GetUpdateRound(system);
             memmove (this->_systemOrder + systemOrderIdx, 
                      this->_systemOrder + systemOrderIdx + 1, 
-                     this->_registeredSystems-- - systemOrderIdx);
+                     (this->_registeredSystems-- - systemOrderIdx - 1) * sizeof(*_systemOrder));
+            this->_systemOrder[this->_registeredSystems] = nullptr;
             assert(ASSERT_OK());
         }
 
+        inline int GetRegisteredCount() const
+        {
+            return this->_registeredSystems;
+        }
+
 
 
 
@@ -238,11 +610,13 @@ public:
         return this->_systemPointers[System<SystemName>::SYSTEM_TYPE_ID];
     }
 
-    SystemManager():
+    SystemManager (World* world):
+        _world (world),
         _systemCount(0),
         systemOrderManager(),
         _isRunning(true),
-        _systemPointers (nullptr)
+        _systemPointers (nullptr),
+        _graphIsDirty (true)
     {}
 
     void Setup()
@@ -271,25 +645,175 @@ public:
         
     }
 
+    // Updates the systems which are due and returns time till the next due one (ms)
     float Update()
     {
+        World::Scope scope (*_world);
+        _world->_clock->NextFrame();
+        return UpdateAt(_world->_clock->Now_nsec());
+    }
+
+    float UpdateAt (int64_t now_nsec)
+    {
+        World::Scope scope (*_world);       // systems work with their own world on this thread
+        PROFILE_FRAME()
+        PROFILE_ZONE("Frame", "frame")
+        int registered = systemOrderManager.GetRegisteredCount();
+
+        if (_graphIsDirty)
+        {
+            BuildDependencyGraph();
+            RebuildSchedule(now_nsec);
+        }
+
+        ScheduleWoken(now_nsec);
+
+        _results.assign(registered, 0.f);
+
         ISystem ** order = systemOrderManager.getSystemOrder();
-        float timeToNext_ms = INFINITY;
-        for (int i = 0; i < this->_systemCount; i++)
+        std::vector<int> due;
+        while (!_schedule.empty() && _schedule.top().first <= now_nsec)
+        {
+            ScheduleEntry entry = _schedule.top();
+            _schedule.pop();
+            if (entry.first == order[entry.second]->_nextUpdate_nsec)
+                due.push_back(entry.second);
+        }
+
+        for (int catchUps = 0; !due.empty(); catchUps++)
+        {
+            std::sort(due.begin(), due.end());      // in order of priority
+            due.erase(std::unique(due.begin(), due.end()), due.end());
+            if (jobSystem.GetThreadsCount() == 1)
+                UpdateSerially(due);
+            else
+                UpdateInParallel(due);
+
+            std::vector<int> overdue;
+            for (int updateRound : due)
+                Reschedule(updateRound, now_nsec, catchUps, overdue);
+            due.swap(overdue);
+        }
+
+        WakeWatchers(now_nsec);
+
+        PROFILE_COUNTER("active systems", GetActiveSystemsCount())
+        PROFILE_COUNTER("work left", GetWorkLeft())
+
+        if (!this->_isRunning)
+            return NAN;
         {
-            float timeToNextUpdate_ms = order[i]->Update();
-            if (timeToNextUpdate_ms < 1000 * order[i]->_updateInterval)
-                timeToNextUpdate_ms = 1000 * order[i]->_updateInterval;
+            std::lock_guard<std::mutex> lock(_wokenMutex);
+            if (!_woken.empty())
+                return 0.f;         // woken up during this frame
+        }
+        while (!_schedule.empty() && _schedule.top().first != order[_schedule.top().second]->_nextUpdate_nsec)
+            _schedule.pop();
+        if (_schedule.empty())
+            return INFINITY;
+
+        int64_t timeToNext_nsec = _schedule.top().first - now_nsec;
+        return timeToNext_nsec > 0 ? timeToNext_nsec / 1e6f : 0.f;
+    }
 
-            if (timeToNext_ms > timeToNextUpdate_ms)
-                timeToNext_ms = timeToNextUpdate_ms;
+    template <typename SystemName>
+    void SetOverrunPolicy (ISystem::OverrunPolicy policy)
+    {
+        if (IsRegistered<SystemName>())
+            this->_systemPointers[System<SystemName>::SYSTEM_TYPE_ID]->_overrunPolicy = policy;
+    }
 
+    // Systems that are not dormant. When only the input system is left, nothing changes
+    // till the user does something, so it may block on input instead of polling
+    int GetActiveSystemsCount()
+    {
+        ISystem ** order = systemOrderManager.getSystemOrder();
+        int registered = systemOrderManager.GetRegisteredCount();
 
+        int active = 0;
+        for (int i = 0; i < registered; i++)
+            active += order[i]->_nextUpdate_nsec != ISystem::DORMANT;
+        {
+            std::lock_guard<std::mutex> lock(_wokenMutex);
+            for (ISystem* system : _woken)
+                active += system->_nextUpdate_nsec == ISystem::DORMANT;
         }
+        return active;
+    }
 
-        return this->_isRunning ? timeToNext_ms : NAN;
+    // The work the systems spread over frames and haven't done yet, in their items
+    int GetWorkLeft()
+    {
+        ISystem ** order = systemOrderManager.getSystemOrder();
+        int registered = systemOrderManager.GetRegisteredCount();
+
+        int workLeft = 0;
+        for (int i = 0; i < registered; i++)
+            workLeft += order[i]->_workLeft;
+        return workLeft;
+    }
+
+    template <typename SystemName>
+    int GetWorkLeft()
+    {
+        if (!IsRegistered<SystemName>())
+            return 0;
+        return this->_systemPointers[System<SystemName>::SYSTEM_TYPE_ID]->_workLeft;
     }
 
+    // Work that may be spread over frames is done by at most items items and time_ms ms
+    // an update, <= 0 being no limit; see WorkQueue. Whatever is left the system reports in
+    // _workLeft, and it is updated at its _updateInterval till it is done, dormant or not
+    template <typename SystemName>
+    void SetBudget (int items, float time_ms = 0.f)
+    {
+        if (!IsRegistered<SystemName>())
+            return;
+        ISystem* system = this->_systemPointers[System<SystemName>::SYSTEM_TYPE_ID];
+        system->_itemsBudget = items;
+        system->_timeBudget_ms = time_ms;
+    }
+
+    // Makes a dormant system due at once, when it got something to do. Thread safe,
+    // takes effect at the next Update()
+    void Wake (ISystem* system)
+    {
+        std::lock_guard<std::mutex> lock(_wokenMutex);
+        _woken.push_back(system);
+    }
+
+    // The system steps by exactly step_sec of world time and catches up when late, so a
+    // frame may run it several times or not at all. Its Update() should take _updateInterval
+    // as the time step and _stepTime_nsec as the current time
+    template <typename SystemName>
+    void SetFixedStep (float step_sec)
+    {
+        if (!IsRegistered<SystemName>())
+            return;
+        ISystem* system = this->_systemPointers[System<SystemName>::SYSTEM_TYPE_ID];
+        system->_fixedStep = true;
+        system->_updateInterval = step_sec;
+        system->_overrunPolicy = ISystem::CATCH_UP;
+    }
+
+    // How far now_nsec is past the last update of a fixed step system, in steps from 0 to 1.
+    // Used to interpolate between the last two states it produced; 1 for other systems.
+    // Asked before the frame's steps of the system ran, it is 1 whenever one is due, so
+    // whoever interpolates has a lower priority
+    template <typename SystemName>
+    float GetStepFraction (int64_t now_nsec)
+    {
+        if (!IsRegistered<SystemName>())
+            return 1.f;
+        ISystem* system = this->_systemPointers[System<SystemName>::SYSTEM_TYPE_ID];
+        if (!system->_fixedStep || system->_stepTime_nsec < 0 || system->_updateInterval <= 0)
+            return 1.f;
+
+        float fraction = (now_nsec - system->_stepTime_nsec) / (1e9f * system->_updateInterval);
+        return fraction < 0.f ? 0.f : (fraction > 1.f ? 1.f : fraction);
+    }
+
+    // Constructs SystemName (World&, Args...) with the world of this manager
     template <typename SystemName, typename... Args>
     SystemName* AddSystem (Args... args)
     {
@@ -299,11 +823,18 @@ public:
             // system already registered
             return nullptr;
 
-        _systemPointers[systemTypeID] = new SystemName(args...);
+        _systemPointers[systemTypeID] = new SystemName(*_world, args...);
         _systemPointers[systemTypeID]->_priority = 0;
+
+        IEventListener* listener = dynamic_cast<IEventListener*>(_systemPointers[systemTypeID]);
+        _systemPointers[systemTypeID]->_listener = listener;
+        if (listener)
+            listener->_wakesUp = _systemPointers[systemTypeID];
+        assert(listener || !_systemPointers[systemTypeID]->_access._eventDriven);
         LOG_LEEKS _LOG( "Allocating %lu bytes at [%p] from %s\n", sizeof(*(_systemPointers[systemTypeID])) * 1, _systemPointers[systemTypeID], __PRETTY_FUNCTION__);
 
         systemOrderManager.UpdateOrder (this->_systemPointers[systemTypeID], -1, -1);
+        _graphIsDirty = true;
 
         return (SystemName*) _systemPointers[systemTypeID];
 
@@ -316,6 +847,7 @@ public:
         SystemName* system = _systemPointers[systemTypeID];
 
         systemOrderManager.RemoveSystem(system);
+        _graphIsDirty = true;
 
         LOG_LEEKS _LOG( "Deleting [%p] from %s\n", system, __PRETTY_FUNCTION__);
         delete system;
@@ -337,6 +869,7 @@ public:
         system->_priority = priority;
 
         this->systemOrderManager.UpdateOrder (this->_systemPointers[System<SystemName>::SYSTEM_TYPE_ID], oldUpdateRound, oldPriority);
+        _graphIsDirty = true;
 
     }
 
@@ -345,7 +878,18 @@ public:
 
 };
 
-SystemManager systemManager;
+// of the current world
+inline SystemManager& GetSystemManager()
+{
+    return *World::GetCurrent()._systemManager;
+}
+
+// wakes the system in its own world, whichever world the sender works with
+inline void IEventListener::OnEventRaised()
+{
+    if (_wakesUp)
+        _wakesUp->GetWorld()._systemManager->Wake(_wakesUp);
+}
 
 #endif // ! __SYSTEM_H__
 
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef __TRIPLE_BUFFER_H__
+#define __TRIPLE_BUFFER_H__
+
+#include <atomic>
+
+// Hands values from one writer thread to one reader thread without locks and without
+// blocking either side. The writer fills GetBack() and publishes it; the reader takes
+// the latest published value with Acquire() and reads GetFront() till the next Acquire().
+// Values published while the reader is busy are dropped in favour of newer ones
+template <typename T>
+class TripleBuffer
+{
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4;         // set in _middle when it holds a value the reader hasn't taken
+
+    T _buffers[3];
+    std::atomic<int> _middle;
+    int _back;                          // owned by the writer
+    int _front;                         // owned by the reader
+
+public:
+
+    TripleBuffer():
+        _middle (1),
+        _back (0),
+        _front (2)
+    {}
+
+    inline T& GetBack()
+    {
+        return _buffers[_back];
+    }
+
+    void Publish()
+    {
+        _back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    inline bool HasFresh() const
+    {
+        return _middle.load(std::memory_order_acquire) & FRESH;
+    }
+
+    // false if nothing was published since the last call, GetFront() stays the same then
+    bool Acquire()
+    {
+        if (!HasFresh())
+            return false;
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    inline const T& GetFront() const
+    {
+        return _buffers[_front];
+    }
+
+};
+
+#endif // ! __TRIPLE_BUFFER_H__
@@ -0,0 +1,58 @@
+#pragma once
+#ifndef __WORK_QUEUE_H__
+#define __WORK_QUEUE_H__
+
+#include <chrono>
+#include <deque>
+
+// Work that doesn't have to be done within one frame. Items wait in the queue, and every
+// Run() goes on from where the last one stopped, for as long as the budget lasts: a count
+// of items, and time if given. Item budgets keep runs reproducible; time budgets follow the
+// machine. A system that keeps one reports what is left in _workLeft, so SystemManager
+// updates it till the work is done, see SystemManager::SetBudget()
+template <typename Item>
+class WorkQueue
+{
+    std::deque<Item> _items;
+
+public:
+
+    inline int GetCount() const
+    {
+        return (int)_items.size();
+    }
+
+    inline bool IsEmpty() const
+    {
+        return _items.empty();
+    }
+
+    void Push (const Item& item)
+    {
+        _items.push_back(item);
+    }
+
+    // Calls function(item) in the order the items were pushed, for itemsBudget items at most
+    // and till timeBudget_ms passes, whichever comes first; <= 0 is no limit. Time is checked
+    // after every item, so one item is done whatever the budget. Returns how many were done
+    template <typename Function>
+    int Run (Function function, int itemsBudget = 0, float timeBudget_ms = 0.f)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        int done = 0;
+        while (!_items.empty() && (itemsBudget <= 0 || done < itemsBudget))
+        {
+            Item item = _items.front();
+            _items.pop_front();
+            function(item);
+            done++;
+
+            if (timeBudget_ms > 0.f
+             && std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - begin).count() >= timeBudget_ms)
+                break;
+        }
+        return done;
+    }
+};
+
+#endif // ! __WORK_QUEUE_H__
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef __WORLD_H__
+#define __WORLD_H__
+
+class WorldClock;
+class ComponentManager;
+class EntityManager;
+class EventManager;
+class SystemManager;
+class SpatialGrid;
+class FloatingOrigin;
+class ActivityRegion;
+
+// One simulation: its clock, entities, components, events, systems, spatial index, floating
+// origin and activity region. Systems are given their world by SystemManager::AddSystem()
+// and keep references to its parts. Elsewhere GetWorldClock(), GetComponentManager(),
+// GetEntityManager(), GetEventManager(), GetSystemManager(), GetSpatialGrid(),
+// GetWorldOrigin() and GetActivityRegion() return the ones of the world bound to the
+// calling thread, or of mainWorld if none is.
+// SystemManager binds its world for the time of an update and jobs run bound to the world
+// that created them, so systems of different worlds never see each other's state.
+// Type IDs and jobSystem are shared by all worlds.
+//     World world;
+//     World::Scope scope (world);     // this thread works with world till scope ends
+//     world.Setup();
+class World
+{
+    static thread_local World* _bound;
+
+public:
+
+    WorldClock* const _clock;
+    ComponentManager* const _componentManager;
+    EntityManager* const _entityManager;
+    EventManager* const _eventManager;
+    SystemManager* const _systemManager;
+    SpatialGrid* const _spatialGrid;
+    FloatingOrigin* const _origin;
+    ActivityRegion* const _activity;
+
+    // defined in ECS.hpp, once the managers are complete
+    World();
+    ~World();
+    void Setup();
+    void RebaseOrigin (int64_t chunk);
+
+    World (const World&) = delete;
+    World& operator= (const World&) = delete;
+
+    static inline World& GetCurrent();
+
+    class Scope
+    {
+        World* _outer;
+
+    public:
+
+        Scope (World& world):
+            _outer (_bound)
+        {
+            _bound = &world;
+        }
+
+        ~Scope()
+        {
+            _bound = _outer;
+        }
+
+        Scope (const Scope&) = delete;
+        Scope& operator= (const Scope&) = delete;
+    };
+};
+
+thread_local World* World::_bound = nullptr;
+
+// The world of single-world programs, used by threads that aren't bound to any
+extern World mainWorld;
+
+inline World& World::GetCurrent()
+{
+    return _bound ? *_bound : mainWorld;
+}
+
+#endif // ! __WORLD_H__
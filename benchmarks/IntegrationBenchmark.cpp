@@ -0,0 +1,166 @@
+// MovingSystem's integration step of 10k, 100k and 1M entities, on one thread:
+//     pointers    the loop over components it runs: position through a pointer,
+//                 wall test on the new position
+//     packed      Integrator kernels over PackedBodies, for every level the CPU has
+//     gathered    gather from components, best kernel, scatter; slower than pointers, so
+//                 MovingSystem keeps its loop till bodies stay packed between updates;
+//                 the kernels, in Integrator.hpp, stay here till then
+// Build from the repository root:
+//     g++ -std=c++20 -O2 -pthread benchmarks/IntegrationBenchmark.cpp -o IntegrationBenchmark
+// Usage: ./IntegrationBenchmark
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <cmath>
+
+#define _LOG(...) ;
+#define LOG_LEEKS if(0)
+
+#include "../ECS/ECS.hpp"
+#include "Integrator.hpp"
+
+struct BenchEntity: public Entity<BenchEntity>
+{};
+
+struct BenchPosition: public Component<BenchPosition>
+{
+    float _x;
+    float _y;
+
+    BenchPosition (entity_id_t owner, float x, float y):
+        _x(x),
+        _y(y)
+    {
+        _owner = owner;
+    }
+};
+
+struct BenchMoving: public Component<BenchMoving>
+{
+    float _speedX;
+    float _speedY;
+    BenchPosition* _position;
+
+    BenchMoving (entity_id_t owner, float speedX, float speedY, BenchPosition* position):
+        _speedX(speedX),
+        _speedY(speedY),
+        _position(position)
+    {
+        _owner = owner;
+    }
+};
+
+const int ITERATIONS = 50;
+const float DT = 1.f / 30;
+const float MIN_Y = 200.f;
+const float MAX_Y = 680.f;
+
+std::vector<entity_id_t> moving;
+PackedBodies bodies;
+volatile int hits;          // keeps the wall tests from being optimized out
+
+template <typename Function>
+double Measure_ms (Function function)
+{
+    function();             // warm up
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        function();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - begin).count() / ITERATIONS;
+}
+
+void IntegratePointers()
+{
+    const std::vector<IComponent*>& components = GetComponentManager().GetEntitiesVector<BenchMoving>();
+    int count = 0;
+    for (IComponent* component : components)
+    {
+        if (!component)
+            continue;
+        BenchMoving* movingComponent = static_cast<BenchMoving*>(component);
+        BenchPosition* position = movingComponent->_position;
+        position->_x = position->_x + DT * movingComponent->_speedX;
+        position->_y = position->_y + DT * movingComponent->_speedY;
+        if (position->_y < MIN_Y || position->_y > MAX_Y)
+            count++;
+    }
+    hits = count;
+}
+
+void IntegrateGathered()
+{
+    const std::vector<IComponent*>& components = GetComponentManager().GetEntitiesVector<BenchMoving>();
+    int count = moving.size();
+    for (int begin = 0; begin < count; begin += 64)
+    {
+        int end = std::min(begin + 64, count);
+        BenchPosition* positions[64];
+        for (int i = begin; i < end; i++)
+        {
+            BenchMoving* movingComponent = static_cast<BenchMoving*>(components[moving[i]]);
+            BenchPosition* position = positions[i - begin] = movingComponent->_position;
+            bodies._x[i] = position->_x;
+            bodies._y[i] = position->_y;
+            bodies._speedX[i] = movingComponent->_speedX;
+            bodies._speedY[i] = movingComponent->_speedY;
+        }
+        Integrator::Integrate(bodies, begin, end, DT);
+        for (int i = begin; i < end; i++)
+        {
+            positions[i - begin]->_x = bodies._x[i];
+            positions[i - begin]->_y = bodies._y[i];
+        }
+    }
+    hits = bodies._outside[0] != 0;
+}
+
+int main()
+{
+    SetupManagers();
+
+    SimdLevel best = Integrator::GetBestLevel();
+    printf("best level: %s\n", Integrator::GetLevelName(best));
+
+    const int entitiesCounts[] = { 10000, 100000, 1000000 };
+    int created = 0;
+
+    printf("%10s %10s %12s %8s\n", "entities", "path", "ms/update", "speedup");
+    for (int entitiesCount : entitiesCounts)
+    {
+        for (; created < entitiesCount; created++)
+        {
+            entity_id_t entity = GetEntityManager().CreateEntityObject<BenchEntity>();
+            BenchPosition* position = GetComponentManager().AddComponent<BenchPosition>(entity, (float)created, MIN_Y + created % 480);
+            GetComponentManager().AddComponent<BenchMoving>(entity, 1.f, (float)(created % 7) - 3.f, position);
+            moving.push_back(entity);
+        }
+
+        bodies.Resize(entitiesCount);
+        for (int i = 0; i < entitiesCount; i++)
+        {
+            bodies._x[i] = (float)i;
+            bodies._y[i] = MIN_Y + i % 480;
+            bodies._speedX[i] = 1.f;
+            bodies._speedY[i] = (float)(i % 7) - 3.f;
+            bodies._minY[i] = MIN_Y;
+            bodies._maxY[i] = MAX_Y;
+        }
+
+        double pointers_ms = Measure_ms(IntegratePointers);
+        printf("%10d %10s %12.3f %8.2f\n", entitiesCount, "pointers", pointers_ms, 1.);
+
+        for (SimdLevel level = SIMD_SCALAR; level <= best; level = (SimdLevel)(level + 1))
+        {
+            double packed_ms = Measure_ms([entitiesCount, level] { Integrator::Integrate(bodies, 0, entitiesCount, DT, level); });
+            printf("%10d %10s %12.3f %8.2f\n", entitiesCount, Integrator::GetLevelName(level), packed_ms, pointers_ms / packed_ms);
+        }
+
+        double gathered_ms = Measure_ms(IntegrateGathered);
+        printf("%10d %10s %12.3f %8.2f\n", entitiesCount, "gathered", gathered_ms, pointers_ms / gathered_ms);
+    }
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+#pragma once
+#ifndef __INTEGRATOR_H__
+#define __INTEGRATOR_H__
+
+#include <cstdint>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define INTEGRATOR_X86
+#include <immintrin.h>
+#endif
+
+// Bodies laid out as one packed array per coordinate, for Integrator. Bit i % 64 of
+// _outside[i / 64] tells if body i is out of its band _minY..._maxY after the last step
+struct PackedBodies
+{
+    std::vector<float> _x;
+    std::vector<float> _y;
+    std::vector<float> _speedX;
+    std::vector<float> _speedY;
+    std::vector<float> _minY;
+    std::vector<float> _maxY;
+    std::vector<uint64_t> _outside;
+
+    void Resize (int count)
+    {
+        _x.resize(count);
+        _y.resize(count);
+        _speedX.resize(count);
+        _speedY.resize(count);
+        _minY.resize(count);
+        _maxY.resize(count);
+        _outside.resize((count + 63) / 64);
+    }
+
+    inline int GetCount() const
+    {
+        return (int)_x.size();
+    }
+
+    inline int GetWordsCount() const
+    {
+        return (int)_outside.size();
+    }
+
+    inline bool IsOutside (int i) const
+    {
+        return (_outside[i / 64] >> (i % 64)) & 1;
+    }
+};
+
+enum SimdLevel
+{
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2
+};
+
+// Moves bodies by dt * speed and tests them against their bands in the same pass.
+// AVX2 takes 8 bodies at a time, SSE2 4, plain code the rest; the best level the CPU has
+// is found once, at the first call. Every level multiplies, then adds, so they agree to the
+// bit unless the compiler fuses the scalar ones into FMA. Integrate() fills whole words of
+// the mask: ranges that run in parallel must begin at multiples of 64
+class Integrator
+{
+    typedef uint64_t (*Kernel) (PackedBodies& bodies, int begin, int count, float dt);
+
+    static uint64_t IntegrateScalar (PackedBodies& bodies, int begin, int count, float dt)
+    {
+        float* x = bodies._x.data() + begin, * y = bodies._y.data() + begin;
+        const float* speedX = bodies._speedX.data() + begin, * speedY = bodies._speedY.data() + begin,
+                   * minY   = bodies._minY.data() + begin,   * maxY   = bodies._maxY.data() + begin;
+
+        uint64_t outside = 0;
+        for (int i = 0; i < count; i++)
+        {
+            x[i] = x[i] + dt * speedX[i];
+            y[i] = y[i] + dt * speedY[i];
+            outside |= (uint64_t)(y[i] < minY[i] || y[i] > maxY[i]) << i;
+        }
+        return outside;
+    }
+
+#ifdef INTEGRATOR_X86
+    __attribute__((target("sse2")))
+    static uint64_t IntegrateSSE2 (PackedBodies& bodies, int begin, int count, float dt)
+    {
+        float* x = bodies._x.data() + begin, * y = bodies._y.data() + begin;
+        const float* speedX = bodies._speedX.data() + begin, * speedY = bodies._speedY.data() + begin,
+                   * minY   = bodies._minY.data() + begin,   * maxY   = bodies._maxY.data() + begin;
+
+        __m128 step = _mm_set1_ps(dt);
+        uint64_t outside = 0;
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 newX = _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(step, _mm_loadu_ps(speedX + i)));
+            __m128 newY = _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(step, _mm_loadu_ps(speedY + i)));
+            _mm_storeu_ps(x + i, newX);
+            _mm_storeu_ps(y + i, newY);
+
+            __m128 out = _mm_or_ps(_mm_cmplt_ps(newY, _mm_loadu_ps(minY + i)), _mm_cmpgt_ps(newY, _mm_loadu_ps(maxY + i)));
+            outside |= (uint64_t)_mm_movemask_ps(out) << i;
+        }
+        if (i < count)
+            outside |= IntegrateScalar(bodies, begin + i, count - i, dt) << i;
+        return outside;
+    }
+
+    __attribute__((target("avx2")))
+    static uint64_t IntegrateAVX2 (PackedBodies& bodies, int begin, int count, float dt)
+    {
+        float* x = bodies._x.data() + begin, * y = bodies._y.data() + begin;
+        const float* speedX = bodies._speedX.data() + begin, * speedY = bodies._speedY.data() + begin,
+                   * minY   = bodies._minY.data() + begin,   * maxY   = bodies._maxY.data() + begin;
+
+        __m256 step = _mm256_set1_ps(dt);
+        uint64_t outside = 0;
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 newX = _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(step, _mm256_loadu_ps(speedX + i)));
+            __m256 newY = _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(step, _mm256_loadu_ps(speedY + i)));
+            _mm256_storeu_ps(x + i, newX);
+            _mm256_storeu_ps(y + i, newY);
+
+            __m256 out = _mm256_or_ps(_mm256_cmp_ps(newY, _mm256_loadu_ps(minY + i), _CMP_LT_OQ),
+                                      _mm256_cmp_ps(newY, _mm256_loadu_ps(maxY + i), _CMP_GT_OQ));
+            outside |= (uint64_t)_mm256_movemask_ps(out) << i;
+        }
+        if (i < count)
+            outside |= IntegrateScalar(bodies, begin + i, count - i, dt) << i;
+        return outside;
+    }
+#endif
+
+    static Kernel GetKernel (SimdLevel level)
+    {
+#ifdef INTEGRATOR_X86
+        if (level == SIMD_AVX2)
+            return IntegrateAVX2;
+        if (level == SIMD_SSE2)
+            return IntegrateSSE2;
+#endif
+        return IntegrateScalar;
+    }
+
+    static SimdLevel DetectLevel()
+    {
+#ifdef INTEGRATOR_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return SIMD_AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return SIMD_SSE2;
+#endif
+        return SIMD_SCALAR;
+    }
+
+public:
+
+    static SimdLevel GetBestLevel()
+    {
+        static const SimdLevel level = DetectLevel();
+        return level;
+    }
+
+    static const char* GetLevelName (SimdLevel level)
+    {
+        switch (level)
+        {
+            case SIMD_AVX2:   return "AVX2";
+            case SIMD_SSE2:   return "SSE2";
+            case SIMD_SCALAR: return "scalar";
+        }
+        return "?";
+    }
+
+    // Bodies [begin, end), begin a multiple of 64
+    static void Integrate (PackedBodies& bodies, int begin, int end, float dt, SimdLevel level = GetBestLevel())
+    {
+        Kernel kernel = GetKernel(level);
+        for (int word = begin / 64; word * 64 < end; word++)
+        {
+            int first = word * 64;
+            int count = end - first < 64 ? end - first : 64;
+            bodies._outside[word] = kernel(bodies, first, count, dt);
+        }
+    }
+};
+
+#endif // ! __INTEGRATOR_H__
@@ -0,0 +1,98 @@
+// Scaling of JobSystem::ParallelForEach over component pools of 10k, 100k and 1M entities.
+// Build from the repository root:
+//     g++ -std=c++20 -O2 -pthread benchmarks/JobSystemBenchmark.cpp -o JobSystemBenchmark
+// Usage: ./JobSystemBenchmark [max threads count]
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+
+#define _LOG(...) ;
+#define LOG_LEEKS if(0)
+
+#include "../ECS/ECS.hpp"
+
+struct BenchEntity: public Entity<BenchEntity>
+{};
+
+struct BenchPosition: public Component<BenchPosition>
+{
+    float _x;
+    float _y;
+
+    BenchPosition (entity_id_t owner, float x, float y):
+        _x(x),
+        _y(y)
+    {
+        _owner = owner;
+    }
+};
+
+struct BenchVelocity: public Component<BenchVelocity>
+{
+    float _x;
+    float _y;
+
+    BenchVelocity (entity_id_t owner, float x, float y):
+        _x(x),
+        _y(y)
+    {
+        _owner = owner;
+    }
+};
+
+const int ITERATIONS = 50;
+const float DT = 1.f / 30;
+
+double MeasureIntegration_ms()
+{
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++)
+        jobSystem.ParallelForEach<BenchPosition, BenchVelocity>(GetComponentManager(), [] (BenchPosition& position, BenchVelocity& velocity)
+        {
+            position._x += DT * velocity._x;
+            position._y += DT * velocity._y;
+        });
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - begin).count() / ITERATIONS;
+}
+
+int main (int argc, char** argv)
+{
+    int maxThreads = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+    if (maxThreads < 1)
+        maxThreads = 1;
+
+    SetupManagers();
+
+    const int entitiesCounts[] = { 10000, 100000, 1000000 };
+    int created = 0;
+
+    printf("%10s %8s %12s %8s\n", "entities", "threads", "ms/update", "speedup");
+    for (int entitiesCount : entitiesCounts)
+    {
+        for (; created < entitiesCount; created++)
+        {
+            entity_id_t entity = GetEntityManager().CreateEntityObject<BenchEntity>();
+            GetComponentManager().AddComponent<BenchPosition>(entity, (float)created, 0.f);
+            GetComponentManager().AddComponent<BenchVelocity>(entity, 1.f, (float)(created % 7));
+        }
+
+        double serial_ms = 0;
+        for (int threads = 1; threads <= maxThreads; threads = threads * 2 > maxThreads && threads != maxThreads ? maxThreads : threads * 2)
+        {
+            jobSystem.Start(threads);
+            MeasureIntegration_ms();        // warm up
+            double update_ms = MeasureIntegration_ms();
+            if (threads == 1)
+                serial_ms = update_ms;
+
+            printf("%10d %8d %12.3f %8.2f\n", entitiesCount, threads, update_ms, serial_ms / update_ms);
+        }
+    }
+
+    jobSystem.Stop();
+    return 0;
+}
@@ -2,12 +2,14 @@
 #include <ctime>
 #include <deque>
 #include <random>
+#include <unordered_map>
 #include <chrono>
 #include <cmath>
-#include <unistd.h>
 #include <cassert>
+#include <algorithm>
 
 //#define DEBUG
+//#define PROFILING     // writes profile.json (Chrome trace) and per-system timings on exit
 
 #ifdef DEBUG
 #define _LOG(...) { FILE* LOG = fopen("debug.log", "a"); fprintf(LOG, __VA_ARGS__); fclose(LOG); }
@@ -24,8 +26,6 @@ void CleanLogFile()
 #define LOG_LEEKS if(0)
 #endif
 
-#define CLOCK CLOCK_REALTIME
-
 #include "ECS/ECS.hpp"
 #include <SFML/Main.hpp>
 #include <SFML/Graphics.hpp>
@@ -36,19 +36,22 @@ const int LOW_WALL_Y  = WINDOW_Y - 200;
 const int HIGH_WALL_Y = 200;
 const int PLAYER_SPEED = 200; // pics/sec
 const float SHOOTING_SPEED = 3; //per second
-const int X_DECREASING = 0x30000000;
 const int CHUNK_SIZE = 10*30;
+const int TILE_SIZE = 30; // pix; of the walls and bricks drawn behind everything
+const int REBASE_CHUNKS = 16; // the origin moves to the player's chunk when the player gets this far from it
 const int MAX_CANNONBALLS_COLLISIONS = 2;
 const int FPS = 30;
 const float FRAMERATE = 1.f / FPS;
 const float CANNONBALL_SPEED = PLAYER_SPEED * 1.1;
 const float FLOAT_PRECISION = 1e-4;
+const float MAX_SUBSTEP_DISTANCE = 15.f; // fast movers step by no more than half a cannonball
+const int MAX_SUBSTEPS = 16;
+const float ACTIVITY_RADIUS = WINDOW_X; // pix; entities farther from the player are dormant. A window past the view's edges
 
-
-int64_t GetTimeBetween_nsec (const struct timespec& t1, const struct timespec& t2)
-{
-    return (t2.tv_sec - t1.tv_sec) * 1e9 + (t2.tv_nsec - t1.tv_nsec);
-}
+// Collision layers: bodies touch when each one's mask has the other one's layer
+const uint32_t LAYER_PLAYER     = 1 << 0;
+const uint32_t LAYER_CANNONBALL = 1 << 1;
+const uint32_t LAYER_TURRET     = 1 << 2;
 
 struct Cannon: public Entity<Cannon>
 {
@@ -73,32 +76,65 @@ struct Cannonball: public Entity<Cannonball>
 
 
 
+// x is kept as a chunk of the world's origin and an offset in it, so positions stay exact
+// however far they are and don't change when the origin moves. The getters count from the origin
 class PositionComponent: public Component<PositionComponent>
 { 
-    sf::Vector2f _position;
+    const FloatingOrigin* _origin;      // of the world the component was made in, and its spatial index
+    SpatialGrid* _grid;
+    int64_t _chunk;
+    sf::Vector2f _offset;               // x from the start of _chunk
+    int64_t _previousChunk;             // before the last MovingSystem step, for interpolated rendering
+    sf::Vector2f _previousOffset;
     
 public:
 
-    sf::Vector2f& getPosition() { return this->_position; }
+    sf::Vector2f getPosition() const { return sf::Vector2f(_origin->ToFloat(this->_chunk, this->_offset.x), this->_offset.y); }
     void setPosition(float x, float y)
     {
-        this->_position.x = x;
-        this->_position.y = y;
+        _origin->ToChunk(x, this->_chunk, this->_offset.x);
+        this->_offset.y = y;
+    }
+
+    sf::Vector2f getPreviousPosition() const { return sf::Vector2f(_origin->ToFloat(this->_previousChunk, this->_previousOffset.x), this->_previousOffset.y); }
+    void savePosition()
+    {
+        this->_previousChunk = this->_chunk;
+        this->_previousOffset = this->_offset;
+    }
+
+    // after the position was changed; not thread safe, unlike setPosition()
+    void updateSpatialIndex()
+    {
+        sf::Vector2f position = getPosition();
+        _grid->Move(_owner, position.x, position.y);
+    }
+
+    // fraction 0 is the previous position, 1 is the current one
+    sf::Vector2f getInterpolatedPosition (float fraction) const
+    {
+        sf::Vector2f previousPosition = getPreviousPosition();
+        return previousPosition + (getPosition() - previousPosition) * fraction;
     }
 
     PositionComponent(entity_id_t owner, float x, float y):
-        _position(x, y) 
+        _origin (&GetWorldOrigin()),
+        _grid (&GetSpatialGrid())
     {
         _owner = owner;
+        setPosition(x, y);
+        savePosition();
+        _grid->Insert(owner, x, y);
     }
 
     PositionComponent (entity_id_t owner, sf::Vector2f& xy):
-        _position(xy)
+        PositionComponent (owner, xy.x, xy.y)
+    {}
+
+    ~PositionComponent()
     {
-        _owner = owner;
+        _grid->Remove(_owner);
     }
-
-    ~PositionComponent() {}
 };
 
 class OrientationComponent: public Component<OrientationComponent>
@@ -189,14 +225,24 @@ struct CollideableComponent: public Component<CollideableComponent>
 {
     sf::Vector2f _widthPos;
     sf::Vector2f _widthNeg;
+    uint32_t _layer;
+    uint32_t _mask;         // layers this body touches
 
-    CollideableComponent (entity_id_t owner, float xpos, float xneg, float ypos, float yneg):
+    CollideableComponent (entity_id_t owner, float xpos, float xneg, float ypos, float yneg,
+                          uint32_t layer = ~0u, uint32_t mask = ~0u):
         _widthPos(xpos, ypos),
-        _widthNeg(xneg, yneg)
+        _widthNeg(xneg, yneg),
+        _layer(layer),
+        _mask(mask)
     {
         _owner = owner;
     }
 
+    bool CanTouch (const CollideableComponent& rhs) const
+    {
+        return (this->_mask & rhs._layer) && (rhs._mask & this->_layer);
+    }
+
     bool DoesCollideWith (float y, float y0)
     {
         return y > y0 - this->_widthNeg.y && y < y0 + this->_widthPos.y; 
@@ -207,19 +253,23 @@ struct CollideableComponent: public Component<CollideableComponent>
         return (x - x0 < 30 && x0 - x < 30) && (y - y0 < 30 && y0 - y < 30);
     }
 
+    // rhs is at (x, y), this one at (x0, y0); boxes that only touch don't collide
     bool DoesCollideWith (CollideableComponent& rhs, float x, float y, float x0, float y0)
     {
-        float left_up_x = x - rhs._widthNeg.x,
-              left_dn_x = x + rhs._widthPos.x,
-              left_up_y = y - rhs._widthNeg.y,
-              left_dn_y = y + rhs._widthPos.y,
-              left_up_x0 = x0 - this->_widthNeg.x,
-              left_dn_x0 = x0 + this->_widthPos.x,
-              left_up_y0 = y0 - this->_widthNeg.y,
-              left_dn_y0 = y0 + this->_widthPos.y;
-        
-        return     (x0 + this->_widthPos.x > x - rhs._widthNeg.x || x + rhs._widthPos.x > x0 - this->_widthNeg.x)
-                && (y0 + this->_widthPos.y > y - rhs._widthNeg.y || y + rhs._widthPos.y > y0 - this->_widthNeg.y);
+        return     (x0 + this->_widthPos.x > x - rhs._widthNeg.x && x + rhs._widthPos.x > x0 - this->_widthNeg.x)
+                && (y0 + this->_widthPos.y > y - rhs._widthNeg.y && y + rhs._widthPos.y > y0 - this->_widthNeg.y);
+    }
+};
+
+// A body fast enough to pass through others in one step. MovingSystem moves it in sub-steps
+// and keeps the path, CollisionSystem sweeps it
+struct FastMoverComponent: public Component<FastMoverComponent>
+{
+    std::vector<sf::Vector2f> _path;    // at the ends of the sub-steps of the last step, from the previous position
+
+    FastMoverComponent (entity_id_t owner)
+    {
+        _owner = owner;
     }
 };
 
@@ -240,20 +290,24 @@ class ShootingComponent: public Component<ShootingComponent>
 
     PositionComponent* _position;
     OrientationComponent* _orientation;
-    struct timespec _timeOfLastShot;
+    int64_t _timeOfLastShot_nsec;
 
     ShootingComponent (entity_id_t owner, PositionComponent* position, OrientationComponent* orientation):
         _position (position),
         _orientation (orientation),
-        _timeOfLastShot({})
+        _timeOfLastShot_nsec (INT64_MIN / 2)     // never shot, so shoots at once
     {
         _owner = owner;
         _orientationCos = -cos((orientation->_angle + 90) * M_PI / 180);
         _orientationSin = -sin((orientation->_angle + 90) * M_PI / 180);
     }
 
-    void Shoot (struct timespec shootTime, sf::Texture* cannonballTexture)
+    // the cannonball is made in world
+    void Shoot (World& world, int64_t shootTime_nsec, sf::Texture* cannonballTexture)
     {
+        EntityManager& entityManager = *world._entityManager;
+        ComponentManager& componentManager = *world._componentManager;
+
         entity_id_t cannonball = entityManager.CreateEntityObject<Cannonball>();
 
         auto position =  _orientationSin < 0 ? 
@@ -261,13 +315,16 @@ class ShootingComponent: public Component<ShootingComponent>
           : componentManager.AddComponent<PositionComponent>(cannonball, _position->getPosition().x - 15, _position->getPosition().y + 15);
 
         auto orientation = componentManager.AddComponent<OrientationComponent>(cannonball, 0);
-        componentManager.AddComponent<DrawingComponent>(cannonball, cannonballTexture, position, orientation);
+        if (cannonballTexture)      // nullptr in headless mode
+            componentManager.AddComponent<DrawingComponent>(cannonball, cannonballTexture, position, orientation);
         componentManager.AddComponent<MovingComponent>(cannonball, _orientationCos * CANNONBALL_SPEED, _orientationSin * CANNONBALL_SPEED, position);
         componentManager.AddComponent<BouncingComponent>(cannonball, 1.f, MAX_CANNONBALLS_COLLISIONS);
-        componentManager.AddComponent<CollideableComponent>(cannonball, 30.f, 0.f, 30.f, 0.f);
+        componentManager.AddComponent<CollideableComponent>(cannonball, 30.f, 0.f, 30.f, 0.f,
+                                                            LAYER_CANNONBALL, LAYER_PLAYER | LAYER_CANNONBALL | LAYER_TURRET);
         componentManager.AddComponent<DeadlyComponent>(cannonball);
+        componentManager.AddComponent<FastMoverComponent>(cannonball);
 
-        _timeOfLastShot = shootTime;
+        _timeOfLastShot_nsec = shootTime_nsec;
     }
 };
 
@@ -312,10 +369,11 @@ struct MovementKeyUp: public Event<MovementKeyUp>
 
 struct EnterPressed: public Event<EnterPressed> {};
 struct PausedOrResumed: public Event<PausedOrResumed> {};
+struct GamePaused: public Event<GamePaused> {};
+struct GameResumed: public Event<GameResumed> {};
+struct WindowExposed: public Event<WindowExposed> {};
 struct GameStarted: public Event<GameStarted> {};
 struct PlayerPassedChunk: public Event<PlayerPassedChunk> {};
-struct XReducing: public Event<XReducing> {};
-struct XReduced: public Event<XReduced> {};
 struct GameOver: public Event<GameOver> {};
 struct ExitGame: public Event<ExitGame> {};
 
@@ -339,18 +397,47 @@ struct PlayerSpawned: public Event<PlayerSpawned>
     {}
 };
 
-struct WallCollision: public Event<WallCollision>
+struct Contact
 {
-    entity_id_t _entityId;
+    entity_id_t _first;     // the smaller id
+    entity_id_t _second;
+    float _time;            // when they met, as a fraction of the step
+};
 
-    WallCollision (int entityId):
-        _entityId(entityId)
+// All the contacts CollisionSystem found in one update
+struct Contacts: public Event<Contacts>
+{
+    std::vector<Contact> _contacts;
+
+    Contacts (const std::vector<Contact>& contacts):
+        _contacts(contacts)
     {}
-}; 
+};
 
 ///**************************************************************************************************
 //   Systems   **************************************************************************************
 
+// Appends the entities of the activity region and, wherever they are, the deadly ones, in the
+// order of ids. Cannonballs are short-lived: they move till their bounce limit destroys them,
+// so none is left dormant behind the player, where nothing else would destroy it
+inline void GatherActive (const ComponentManager& componentManager, const SpatialGrid& grid,
+                          const ActivityRegion& region, std::vector<entity_id_t>& active)
+{
+    const std::vector<IComponent*>& deadly = componentManager.GetEntitiesVector<DeadlyComponent>();
+    int deadlyCount = deadly.size();
+
+    int begin = active.size();
+    region.Query(grid, active);
+    active.erase(std::remove_if(active.begin() + begin, active.end(), [&deadly, deadlyCount] (entity_id_t entity)
+    {
+        return entity < deadlyCount && deadly[entity];
+    }), active.end());
+    for (entity_id_t entity = 0; entity < deadlyCount; entity++)
+        if (deadly[entity])
+            active.push_back(entity);
+    std::sort(active.begin() + begin, active.end());
+}
+
 class DrivingSystem: public System <DrivingSystem>, public IEventListener 
 {                                                          //MovementKeyDown, MovementKeyUp, PlayerSpawned, PlayerDied GameOver
     entity_id_t _driveableId;
@@ -367,10 +454,14 @@ class DrivingSystem: public System <DrivingSystem>, public IEventListener
 
 public:
 
-    DrivingSystem ():
+    DrivingSystem (World& world):
+        System(world),
         _driveableId (-1)
     {
         _updateInterval = FRAMERATE;
+        Receives<MovementKeyDown, MovementKeyUp, PlayerSpawned, GameOver>();
+        Writes<MovingComponent>();
+        EventDriven();
         _wasdDown[0] = false;
         _wasdDown[1] = false;
         _wasdDown[2] = false;
@@ -381,7 +472,7 @@ public:
     {
         int speed_x = -_wasdDown[_a] + _wasdDown[_d];
         int speed_y = -_wasdDown[_w] + _wasdDown[_s];
-        MovingComponent* moving = componentManager.GetComponent<MovingComponent>(_driveableId);
+        MovingComponent* moving = _componentManager.GetComponent<MovingComponent>(_driveableId);
         //TODO: MovingComponent-ы в DrivingSystem полем
         moving->_speed.x = speed_x * PLAYER_SPEED;
         moving->_speed.y = speed_y * PLAYER_SPEED;
@@ -393,7 +484,7 @@ public:
         {
             id_t eventId = this->_raisedEvents[i];
 
-            IEvent* event = eventManager.GetEvent(eventId);
+            IEvent* event = _eventManager.GetEvent(eventId);
             
             if (event->_eventTypeId == Event<MovementKeyDown>::EVENT_TYPE_ID)
             {
@@ -434,7 +525,7 @@ public:
             else
                 _LOG( "ERROR: incorrect event type in DrivingSystem: %d\n", event->_eventTypeId);
 
-            eventManager.EventHandled(eventId, *this);
+            _eventManager.EventHandled(eventId, *this);
         }
 
         if (DriveableEntityPresent()) UpdateSpeed();
@@ -446,10 +537,16 @@ public:
     }
 };
 
-class MovingSystem: public System<MovingSystem>, public IEventListener //PlayerSpawned, PlayerDied GameOver
+class MovingSystem: public System<MovingSystem>, public IEventListener //PlayerSpawned, PlayerDied GameOver, GamePaused, GameResumed
 {
-    struct timespec _timeOfLastUpdate;
+    int64_t _timeOfLastUpdate_nsec;
     int _playerId;
+    bool _dormant;
+    bool _paused;
+    std::vector<entity_id_t> _active;
+    std::vector<entity_id_t> _moving;
+    std::vector<char> _broken;              // [i]: _moving[i] hit the walls too many times
+    std::vector<entity_id_t> _destroyed;
 
     void CheckEvents()
     {
@@ -457,7 +554,7 @@ class MovingSystem: public System<MovingSystem>, public IEventListener //PlayerS
         for (int i = 0; i < size; i++)
         {
             id_t eventId = this->_raisedEvents[i];
-            IEvent* event = eventManager.GetEvent(eventId);
+            IEvent* event = _eventManager.GetEvent(eventId);
             if (event->_eventTypeId == Event<PlayerSpawned>::EVENT_TYPE_ID)
             {
                 _playerId = (dynamic_cast<PlayerSpawned*>(event))->playerId;
@@ -466,33 +563,81 @@ class MovingSystem: public System<MovingSystem>, public IEventListener //PlayerS
             else if (event->_eventTypeId == Event<GameOver>::EVENT_TYPE_ID)
             {
                 _playerId = -1;
+                _paused = false;
+            }
+            else if (event->_eventTypeId == Event<GamePaused>::EVENT_TYPE_ID)
+            {
+                _paused = true;
+            }
+            else if (event->_eventTypeId == Event<GameResumed>::EVENT_TYPE_ID)
+            {
+                _paused = false;
             }
             else
             {
                 _LOG("Unknown event type in MovingSystem: %d\n", event->_eventTypeId);
             }
 
-            eventManager.EventHandled(eventId, *this);
+            _eventManager.EventHandled(eventId, *this);
 
         }
         this->_raisedEvents.clear();
     }
 
-    float GetTimeSinceLastUpdate (struct timespec& currentTime)
+    // Reflects a body at y off the walls till it is between minY and maxY; false if it
+    // reached its collisions limit instead
+    static bool Bounce (float& y, sf::Vector2f& speed, float minY, float maxY, BouncingComponent& bouncing)
+    {
+        while (true)
+        {
+            float distance = maxY - y;          // to the low wall
+            if (distance >= -FLOAT_PRECISION)
+            {
+                distance = minY - y;            // to the high wall
+                if (distance <= FLOAT_PRECISION)
+                    return true;
+            }
+
+            if ((bouncing._collisionsCount)++ >= bouncing._maxCollisions && bouncing._maxCollisions > 0)
+                return false;
+
+            y += distance * (1 + bouncing._bouncing);
+            //speed.x *= bouncing._bouncing; TODO: add horizontal bouncing
+            speed.y *= -bouncing._bouncing;
+        }
+    }
+
+    float GetTimeSinceLastUpdate (int64_t currentTime_nsec)
     {
-        float ret = 1e-9 * (currentTime.tv_nsec - _timeOfLastUpdate.tv_nsec);
-        if (ret < 0) return ret + 1;
-        return ret;
+        return 1e-9 * (currentTime_nsec - _timeOfLastUpdate_nsec);
+    }
+
+    // The activity region is around the player; it stays where it is once there is none
+    void CenterActivityRegion()
+    {
+        if (_playerId == -1)
+            return;
+        sf::Vector2f position = _componentManager.GetComponent<PositionComponent>(_playerId)->getPosition();
+        _activityRegion.MoveTo(position.x, position.y);
     }
 
 public:
 
-    MovingSystem():
-        _timeOfLastUpdate({}),
-        _playerId(-1)
+    MovingSystem (World& world):
+        System(world),
+        _timeOfLastUpdate_nsec(_worldClock.Now_nsec()),
+        _playerId(-1),
+        _dormant(false),
+        _paused(false)
     {
         _updateInterval = FRAMERATE;
-        clock_gettime(CLOCK, &_timeOfLastUpdate);
+        Receives<PlayerSpawned, GameOver, GamePaused, GameResumed>();
+        Sends<PlayerPassedChunk>();
+        Reads<HealthComponent>();
+        Writes<PositionComponent, OrientationComponent, DrawingComponent, MovingComponent,     // destroys cannonballs
+               BouncingComponent, CollideableComponent, DeadlyComponent, FastMoverComponent>();
+        ChangesStructure();
+        WakesOnChangeOf<MovingComponent>();
     }
 
     virtual ~MovingSystem()
@@ -502,92 +647,118 @@ public:
     {
         CheckEvents();
 
-        struct timespec currentTime = {};
-        clock_gettime(CLOCK, &currentTime);
-
-        float timeSinceLastUpdate = GetTimeSinceLastUpdate(currentTime);
-                                                                   //TODO: rename function
-        std::vector<IComponent*> movingComponents = componentManager.GetEntitiesVector<MovingComponent>(),
-                            bouncingComponents    = componentManager.GetEntitiesVector<BouncingComponent>(),
-                            deadlyComponents      = componentManager.GetEntitiesVector<DeadlyComponent>(),
-                            collideableComponents = componentManager.GetEntitiesVector<CollideableComponent>(),
-                            healthComponents      = componentManager.GetEntitiesVector<HealthComponent>();      //only 1, player's
-
+        int64_t currentTime_nsec = _fixedStep ? _stepTime_nsec : _worldClock.Now_nsec();
 
-        float playerOldX = _playerId == -1 ? 0.f : componentManager.GetComponent<PositionComponent>(_playerId)->getPosition().x;
-
-        for (int i = 0; i < movingComponents.size(); i++)
+        if (_paused || _componentManager.GetComponentsCount<MovingComponent>() == 0)
         {
-            MovingComponent* movingComponent = dynamic_cast<MovingComponent*>(movingComponents[i]);
-            if (movingComponents[i] == nullptr) continue;
-
-            // Update position
-            PositionComponent* positionComponent = movingComponent->_positionComponent;
-            float old_x = positionComponent->getPosition().x,
-                  old_y = positionComponent->getPosition().y,
-                  new_x = old_x + timeSinceLastUpdate * (movingComponent)->_speed.x,
-                  new_y = old_y + timeSinceLastUpdate * (movingComponent)->_speed.y;
-
-            //positionComponent->_position.x += new_x - old_x;
-            //positionComponent->_position.y += new_y - old_y;
-            positionComponent->setPosition (positionComponent->getPosition().x + new_x - old_x, positionComponent->getPosition().y + new_y - old_y);
-
-
-            // обработка возможного столкновения со стеной
-            BouncingComponent* bouncingComponent = dynamic_cast<BouncingComponent*>(bouncingComponents[i]);
-            CollideableComponent* collideableComponent = dynamic_cast<CollideableComponent*>(collideableComponents[i]);
+            _dormant = true;
+            return INFINITY;            // till the game is resumed or someone spawns a moving entity
+        }
+        if (_dormant)
+        {
+            _timeOfLastUpdate_nsec = currentTime_nsec;      // nothing moved while dormant
+            _dormant = false;
+        }
 
-            if (bouncingComponent)
+        float timeSinceLastUpdate = _fixedStep ? _updateInterval : GetTimeSinceLastUpdate(currentTime_nsec);
+                                                                   //TODO: rename function
+        const std::vector<IComponent*>& movingComponents      = _componentManager.GetEntitiesVector<MovingComponent>(),
+                                      & bouncingComponents    = _componentManager.GetEntitiesVector<BouncingComponent>(),
+                                      & collideableComponents = _componentManager.GetEntitiesVector<CollideableComponent>(),
+                                      & fastMovers            = _componentManager.GetEntitiesVector<FastMoverComponent>();
+        int movingCount = movingComponents.size(), fastMoversCount = fastMovers.size();
+
+        float playerOldX = _playerId == -1 ? 0.f : _componentManager.GetComponent<PositionComponent>(_playerId)->getPosition().x;
+
+        // only what is in the activity region and cannonballs move, in the order of ids whatever the spatial index's is
+        CenterActivityRegion();
+        _active.clear();
+        GatherActive(_componentManager, _spatialGrid, _activityRegion, _active);
+
+        _moving.clear();
+        float fastestSpeed = 0.f;
+        for (entity_id_t entity : _active)
+            if (entity < movingCount && movingComponents[entity])
             {
-                if (collideableComponent->DoesCollideWith(LOW_WALL_Y,  new_y) || LOW_WALL_Y  < new_y
-                ||  collideableComponent->DoesCollideWith(HIGH_WALL_Y, new_y) || HIGH_WALL_Y > new_y)
+                _moving.push_back(entity);
+                if (entity < fastMoversCount && fastMovers[entity])
                 {
-                    _LOG("EVENT: Wall collision: entity %d (%f, %f)<-(%f,%f)\n", i, new_x, new_y, old_x, old_y);
-                    eventManager.SendEvent<WallCollision>(i);
+                    sf::Vector2f speed = static_cast<MovingComponent*>(movingComponents[entity])->_speed;
+                    fastestSpeed = std::max(fastestSpeed, std::hypot(speed.x, speed.y));
                 }
-
             }
+        int count = _moving.size();
+        _broken.resize(count);
 
+        // as many as fast movers need not to jump over anything; one at usual rates
+        int substeps = std::min(MAX_SUBSTEPS, std::max(1, (int)std::ceil(fastestSpeed * timeSinceLastUpdate / MAX_SUBSTEP_DISTANCE)));
+        float substep = timeSinceLastUpdate / substeps;
 
-            //обработка возможного столкновения с игроком
-
-            DeadlyComponent* deadlyComponent = i < deadlyComponents.size() && deadlyComponents[i] ? dynamic_cast<DeadlyComponent*>(deadlyComponents[i]) : nullptr;
-            if (deadlyComponent)
+        // Update positions and bounce off the walls
+        jobSystem.ParallelFor(0, count, [&, substeps, substep] (int i)
+        {
+            entity_id_t entity = _moving[i];
+            MovingComponent* moving = static_cast<MovingComponent*>(movingComponents[entity]);
+            PositionComponent* position = moving->_positionComponent;
+            position->savePosition();
+            sf::Vector2f start = position->getPosition(), at = start;
+
+            // bouncing bodies hit a wall once their edge crosses it
+            BouncingComponent* bouncing = static_cast<BouncingComponent*>(bouncingComponents[entity]);
+            CollideableComponent* collideable = static_cast<CollideableComponent*>(collideableComponents[entity]);
+            float minY = bouncing ? HIGH_WALL_Y + collideable->_widthNeg.y : -INFINITY,
+                  maxY = bouncing ? LOW_WALL_Y  - collideable->_widthPos.y :  INFINITY;
+
+            FastMoverComponent* fast = entity < fastMoversCount ? static_cast<FastMoverComponent*>(fastMovers[entity]) : nullptr;
+            if (fast)
             {
-                entity_id_t thisEntity = _playerId;
-
-                CollideableComponent* thisCollideableComponent = dynamic_cast<CollideableComponent*>(collideableComponents[thisEntity]);
-                PositionComponent* thisPositionComponent = (dynamic_cast<MovingComponent*>(movingComponents[thisEntity]))->_positionComponent;
+                fast->_path.clear();
+                fast->_path.push_back(sf::Vector2f(0.f, 0.f));
+            }
 
-                if (thisCollideableComponent->DoesCollideWith_30x30 (positionComponent->getPosition().x, //TODO: DoesCollide принимает ID сущностей
-                    positionComponent->getPosition().y, thisPositionComponent->getPosition().x, thisPositionComponent->getPosition().y))
-                {
-                    eventManager.SendEvent<EntityHurt>();
-                    _LOG("EVENT: Cannonball %d (%f,%f) collided w/ player (%f,%f)\n", i,  positionComponent->getPosition().x, positionComponent->getPosition().y,
-                    thisPositionComponent->getPosition().x, thisPositionComponent->getPosition().y);
-                    _LOG("Destroying called from line %d\n", __LINE__);
-                    entityManager.DestroyEntityObject(i);
-                }
+            bool broken = false;
+            for (int step = 0; step < substeps; step++)
+            {
+                at.x = at.x + substep * moving->_speed.x;
+                at.y = at.y + substep * moving->_speed.y;
+                if ((at.y < minY || at.y > maxY) && !broken)
+                    broken = !Bounce(at.y, moving->_speed, minY, maxY, *bouncing);
 
+                if (fast)
+                    fast->_path.push_back(at - start);
             }
+            _broken[i] = broken;
 
-            //if have bouncing and bumped on wall, distruct
+            position->setPosition(at.x, at.y);
+        });
 
+        _destroyed.clear();
+        for (int i = 0; i < count; i++)
+        {
+            entity_id_t entity = _moving[i];
+            if (_broken[i])
+            {
+                _LOG("Cannonball %d reached its collisions limit, destroy\n", entity);
+                _LOG("Destroying called from line %d\n", __LINE__);
+                _destroyed.push_back(entity);
+            }
+            else
+                static_cast<MovingComponent*>(movingComponents[entity])->_positionComponent->updateSpatialIndex();
         }
+        _entityManager.DestroyEntityObjects(_destroyed);
 
-        this->_timeOfLastUpdate = currentTime;
+        this->_timeOfLastUpdate_nsec = currentTime_nsec;
 
         if (_playerId != -1)
         {
-            float playerNewX = componentManager.GetComponent<PositionComponent>(_playerId)->getPosition().x;
+            float playerNewX = _componentManager.GetComponent<PositionComponent>(_playerId)->getPosition().x;
             if ((int)(playerOldX / CHUNK_SIZE) < (int)(playerNewX / CHUNK_SIZE))
-            {
-                eventManager.SendEvent<PlayerPassedChunk>();
+                _eventManager.SendEvent<PlayerPassedChunk>();
 
-                if (playerNewX > 2 * X_DECREASING)
-                    eventManager.SendEvent<XReducing>();
-
-            }
+            // floats are precise near the origin; positions don't move with it, so it's cheap
+            if (playerNewX >= REBASE_CHUNKS * CHUNK_SIZE)
+                GetWorld().RebaseOrigin(_worldOrigin.GetChunk() + (int64_t)std::floor(playerNewX / CHUNK_SIZE));
+            CenterActivityRegion();
         }
 
         return 0;
@@ -598,111 +769,399 @@ public:
 
 };
 
-class WallCollisionSystem: public System<WallCollisionSystem>, public IEventListener //WallCollision
-{ 
+// Finds the collideable bodies that overlap. Sweep and prune along x, the way the level
+// stretches: bodies stay sorted by their left edges from update to update, so sorting the
+// nearly sorted order is about linear, and a body is tested only against the ones whose
+// left edges come before its right edge. The exact AABB test and the layers filter those
+// pairs. All the contacts of an update are sent in one Contacts event. Dormant bodies,
+// out of the activity region and not cannonballs, are left out
+class CollisionSystem: public System<CollisionSystem>, public IEventListener //GamePaused, GameResumed, GameOver
+{
+    struct Body
+    {
+        float _minX;                    // of all the places it was at during the step
+        float _maxX;
+        float _minY;
+        float _maxY;
+        float _left;                    // where it is
+        float _right;
+        float _top;
+        float _bottom;
+        uint32_t _layer;
+        uint32_t _mask;
+        entity_id_t _entity;
+        bool _fast;
+    };
+
+    std::vector<entity_id_t> _order;        // by left edges in the last update
+    std::vector<char> _isInOrder;           // [entityId]
+    std::vector<entity_id_t> _active;
+    std::vector<Body> _bodies;
+    std::vector<std::vector<Contact>> _contacts_byThread;
+    std::vector<Contact> _contacts;
+    bool _paused;
 
-    bool IncremCollisions_DestroyIfNeeded (BouncingComponent& bouncing)
+    void CheckEvents()
     {
-        if ((bouncing._collisionsCount)++ >= bouncing._maxCollisions && bouncing._maxCollisions > 0)
+        int size = this->_raisedEvents.size();
+        for (int i = 0; i < size; i++)
         {
-            _LOG("Cannonball %d reached %d collisions, destroy\n", bouncing._owner, bouncing._collisionsCount);
-            _LOG("Destroying called from line %d\n", __LINE__);
-            entityManager.DestroyEntityObject(bouncing._owner);
+            IEvent* event = _eventManager.GetEvent(this->_raisedEvents[i]);
+            if (event->_eventTypeId == Event<GamePaused>::EVENT_TYPE_ID)
+                _paused = true;
+            else if (event->_eventTypeId == Event<GameResumed>::EVENT_TYPE_ID
+                  || event->_eventTypeId == Event<GameOver>::EVENT_TYPE_ID)
+                _paused = false;
+            else
+                _LOG("Unknown event type in CollisionSystem: %d\n", event->_eventTypeId);
+
+            _eventManager.EventHandled(this->_raisedEvents[i], *this);
+        }
+        this->_raisedEvents.clear();
+    }
+
+    // Where body was at the ends of sub-step step of substeps
+    static void GetSubstep (PositionComponent& position, FastMoverComponent* fast, int step, int substeps,
+                            sf::Vector2f& from, sf::Vector2f& to)
+    {
+        sf::Vector2f previous = position.getPreviousPosition();
+        if (fast && (int)fast->_path.size() == substeps + 1)
+        {
+            from = previous + fast->_path[step];
+            to   = previous + fast->_path[step + 1];
+            return;
+        }
+        sf::Vector2f motion = position.getPosition() - previous;
+        from = previous + motion * ((float)step / substeps);
+        to   = previous + motion * ((float)(step + 1) / substeps);
+    }
+
+    // Swept AABB: whether the boxes meet while moving straight from their from to their to
+    // positions, and when, as a fraction of the way. Boxes that only touch don't meet
+    static bool Sweep (const CollideableComponent& lhs, sf::Vector2f lhsFrom, sf::Vector2f lhsTo,
+                       const CollideableComponent& rhs, sf::Vector2f rhsFrom, sf::Vector2f rhsTo, float& time)
+    {
+        sf::Vector2f motion = (lhsTo - lhsFrom) - (rhsTo - rhsFrom);     // of lhs, with rhs standing still
+        float enter = -INFINITY, exit = INFINITY;
+
+        auto axis = [&enter, &exit] (float lhsMin, float lhsMax, float rhsMin, float rhsMax, float motion)
+        {
+            if (motion == 0.f)
+                return lhsMax > rhsMin && rhsMax > lhsMin;
+            float t0 = (rhsMin - lhsMax) / motion, t1 = (rhsMax - lhsMin) / motion;
+            enter = std::max(enter, std::min(t0, t1));
+            exit  = std::min(exit,  std::max(t0, t1));
             return true;
+        };
+
+        if (!axis(lhsFrom.x - lhs._widthNeg.x, lhsFrom.x + lhs._widthPos.x, rhsFrom.x - rhs._widthNeg.x, rhsFrom.x + rhs._widthPos.x, motion.x)
+         || !axis(lhsFrom.y - lhs._widthNeg.y, lhsFrom.y + lhs._widthPos.y, rhsFrom.y - rhs._widthNeg.y, rhsFrom.y + rhs._widthPos.y, motion.y)
+         || enter >= exit || enter >= 1.f || exit <= 0.f)
+            return false;
+
+        time = std::max(enter, 0.f);
+        return true;
+    }
+
+    // Bodies of the activity region and cannonballs in the order of the last update, the new
+    // ones at the end
+    void GatherBodies()
+    {
+        const std::vector<IComponent*>& collideables = _componentManager.GetEntitiesVector<CollideableComponent>();
+        const std::vector<IComponent*>& positions    = _componentManager.GetEntitiesVector<PositionComponent>();
+        const std::vector<IComponent*>& fastMovers   = _componentManager.GetEntitiesVector<FastMoverComponent>();
+        const std::vector<IComponent*>& deadly       = _componentManager.GetEntitiesVector<DeadlyComponent>();
+        int size = std::min(collideables.size(), positions.size());
+        int deadlyCount = deadly.size();
+        _isInOrder.resize(collideables.size(), false);
+
+        int kept = 0;
+        for (entity_id_t entity : _order)
+        {
+            if (entity < size && collideables[entity] && positions[entity]
+             && ((entity < deadlyCount && deadly[entity])
+              || _activityRegion.Contains(static_cast<PositionComponent*>(positions[entity])->getPosition().x,
+                                          static_cast<PositionComponent*>(positions[entity])->getPosition().y)))
+                _order[kept++] = entity;
+            else
+                _isInOrder[entity] = false;
         }
+        _order.resize(kept);
 
-        return false;
-    } 
+        _active.clear();
+        GatherActive(_componentManager, _spatialGrid, _activityRegion, _active);
+        for (entity_id_t entity : _active)
+            if (entity < size && collideables[entity] && positions[entity] && !_isInOrder[entity])
+            {
+                _order.push_back(entity);
+                _isInOrder[entity] = true;
+            }
+
+        int fastMoversCount = fastMovers.size();
+        _bodies.resize(_order.size());
+        jobSystem.ParallelFor(0, (int)_order.size(), [this, &collideables, &positions, &fastMovers, fastMoversCount] (int i)
+        {
+            entity_id_t entity = _order[i];
+            CollideableComponent* collideable = static_cast<CollideableComponent*>(collideables[entity]);
+            PositionComponent* position = static_cast<PositionComponent*>(positions[entity]);
+            FastMoverComponent* fast = entity < fastMoversCount ? static_cast<FastMoverComponent*>(fastMovers[entity]) : nullptr;
+            sf::Vector2f current = position->getPosition(), previous = position->getPreviousPosition();
+
+            Body& body = _bodies[i];
+            body._left   = current.x - collideable->_widthNeg.x;
+            body._right  = current.x + collideable->_widthPos.x;
+            body._top    = current.y - collideable->_widthNeg.y;
+            body._bottom = current.y + collideable->_widthPos.y;
+
+            sf::Vector2f min = sf::Vector2f(std::min(current.x, previous.x), std::min(current.y, previous.y)),
+                         max = sf::Vector2f(std::max(current.x, previous.x), std::max(current.y, previous.y));
+            if (fast)
+                for (const sf::Vector2f& point : fast->_path)
+                {
+                    min = sf::Vector2f(std::min(min.x, previous.x + point.x), std::min(min.y, previous.y + point.y));
+                    max = sf::Vector2f(std::max(max.x, previous.x + point.x), std::max(max.y, previous.y + point.y));
+                }
+            body._minX = min.x - collideable->_widthNeg.x;
+            body._maxX = max.x + collideable->_widthPos.x;
+            body._minY = min.y - collideable->_widthNeg.y;
+            body._maxY = max.y + collideable->_widthPos.y;
+
+            body._layer = collideable->_layer;
+            body._mask = collideable->_mask;
+            body._entity = entity;
+            body._fast = fast != nullptr;
+        });
+    }
+
+    void SortBodies()
+    {
+        for (int i = 1; i < (int)_bodies.size(); i++)
+        {
+            Body body = _bodies[i];
+            int j = i - 1;
+            for (; j >= 0 && _bodies[j]._minX > body._minX; j--)
+                _bodies[j + 1] = _bodies[j];
+            _bodies[j + 1] = body;
+        }
+
+        for (int i = 0; i < (int)_bodies.size(); i++)
+            _order[i] = _bodies[i]._entity;
+    }
+
+    void FindContacts()
+    {
+        int threadsCount = jobSystem.GetThreadsCount();
+        _contacts_byThread.resize(threadsCount);
+        for (std::vector<Contact>& contacts : _contacts_byThread)
+            contacts.clear();
+
+        int size = _bodies.size();
+        jobSystem.ParallelFor(0, size, [this, size] (int i)
+        {
+            int thread = jobSystem.GetWorkerIndex() < 0 ? 0 : jobSystem.GetWorkerIndex();
+            const Body& lhs = _bodies[i];
+            for (int j = i + 1; j < size && _bodies[j]._minX < lhs._maxX; j++)
+            {
+                const Body& rhs = _bodies[j];
+                if (!(lhs._minY < rhs._maxY && rhs._minY < lhs._maxY
+                   && (lhs._mask & rhs._layer) && (rhs._mask & lhs._layer)))
+                    continue;
+
+                float time = 1.f;
+                bool touch = lhs._fast || rhs._fast ? Touch(_componentManager, lhs._entity, rhs._entity, time)
+                                                    : lhs._left < rhs._right && rhs._left < lhs._right
+                                                   && lhs._top < rhs._bottom && rhs._top < lhs._bottom;
+                if (touch)
+                    _contacts_byThread[thread].push_back(lhs._entity < rhs._entity ? Contact { lhs._entity, rhs._entity, time }
+                                                                                   : Contact { rhs._entity, lhs._entity, time });
+            }
+        });
+
+        // same contacts in the same order whatever the threads count is
+        _contacts.clear();
+        for (std::vector<Contact>& contacts : _contacts_byThread)
+            _contacts.insert(_contacts.end(), contacts.begin(), contacts.end());
+        std::sort(_contacts.begin(), _contacts.end(), [] (const Contact& lhs, const Contact& rhs)
+        {
+            return lhs._first < rhs._first || (lhs._first == rhs._first && lhs._second < rhs._second);
+        });
+    }
 
-    
-    
 public:
 
-    WallCollisionSystem()
+    template <typename ComponentName>
+    static ComponentName* Find (const ComponentManager& componentManager, entity_id_t entity)
+    {
+        const std::vector<IComponent*>& components = componentManager.GetEntitiesVector<ComponentName>();
+        return entity < (entity_id_t)components.size() ? static_cast<ComponentName*>(components[entity]) : nullptr;
+    }
+
+    // Whether the bodies met during the last step, and when, as a fraction of it. Fast movers
+    // are swept along their paths sub-step by sub-step, so they pass through nothing; other
+    // bodies are compared where they are
+    static bool Touch (const ComponentManager& componentManager, entity_id_t first, entity_id_t second, float& time)
+    {
+        CollideableComponent* lhs = Find<CollideableComponent>(componentManager, first), * rhs = Find<CollideableComponent>(componentManager, second);
+        PositionComponent* lhsPosition = Find<PositionComponent>(componentManager, first), * rhsPosition = Find<PositionComponent>(componentManager, second);
+        if (!(lhs && rhs && lhsPosition && rhsPosition))
+            return false;
+
+        FastMoverComponent* lhsFast = Find<FastMoverComponent>(componentManager, first), * rhsFast = Find<FastMoverComponent>(componentManager, second);
+        if (!lhsFast && !rhsFast)
+        {
+            time = 1.f;
+            sf::Vector2f lhsAt = lhsPosition->getPosition(), rhsAt = rhsPosition->getPosition();
+            return lhs->DoesCollideWith(*rhs, rhsAt.x, rhsAt.y, lhsAt.x, lhsAt.y);
+        }
+
+        int substeps = std::max({ 1, lhsFast ? (int)lhsFast->_path.size() - 1 : 0,
+                                     rhsFast ? (int)rhsFast->_path.size() - 1 : 0 });
+        for (int step = 0; step < substeps; step++)
+        {
+            sf::Vector2f lhsFrom, lhsTo, rhsFrom, rhsTo;
+            GetSubstep(*lhsPosition, lhsFast, step, substeps, lhsFrom, lhsTo);
+            GetSubstep(*rhsPosition, rhsFast, step, substeps, rhsFrom, rhsTo);
+            float fraction;
+            if (Sweep(*lhs, lhsFrom, lhsTo, *rhs, rhsFrom, rhsTo, fraction))
+            {
+                time = (step + fraction) / substeps;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    CollisionSystem (World& world):
+        System(world),
+        _paused(false)
     {
         _updateInterval = FRAMERATE;
+        Receives<GamePaused, GameResumed, GameOver>();
+        Sends<Contacts>();
+        Reads<PositionComponent, CollideableComponent, FastMoverComponent, DeadlyComponent>();
+        WakesOnChangeOf<CollideableComponent>();
     }
 
-    virtual ~WallCollisionSystem() {}
+    virtual ~CollisionSystem() {}
 
     virtual float Update() override
     {
-        int size = this->_raisedEvents.size();
-        id_t eventId = -1;
-        for (; size > 0; eventManager.EventHandled(eventId, *this))
-        {
-            eventId = this->_raisedEvents[--size];
-            this->_raisedEvents.pop_back();
+        CheckEvents();
+        if (_paused || _componentManager.GetComponentsCount<CollideableComponent>() < 2)
+            return INFINITY;            // till the game is resumed or there is something to collide
 
-            WallCollision* event = dynamic_cast<WallCollision*> (eventManager.GetEvent(eventId)); //TODO: почему не давать в стек сразу указатель?
+        GatherBodies();
+        SortBodies();
+        FindContacts();
 
-            entity_id_t entityId = event->_entityId;
+        if (!_contacts.empty())
+            _eventManager.SendEvent<Contacts>(_contacts);
 
+        return 0;
+    }
+};
 
-            PositionComponent* position       = componentManager.GetComponent<PositionComponent>(entityId);
-            CollideableComponent* collideable = componentManager.GetComponent<CollideableComponent>(entityId);
-            BouncingComponent* bouncing       = componentManager.GetComponent<BouncingComponent>(entityId);
+// What happens on contact: a cannonball hurts the player and breaks, cannonballs that hit
+// each other break, and turrets stop cannonballs. Contacts are checked again, because
+// their bodies may have been destroyed since, and their ids given to new entities
+class ImpactSystem: public System<ImpactSystem>, public IEventListener //Contacts
+{
+    std::vector<entity_id_t> _broken;
+    std::vector<char> _isBroken;    // per entity, set for the entities in _broken
 
-            if(!(position && collideable && bouncing))
-                continue;                           // because this entity was already destroyed
+    inline bool IsBroken (entity_id_t entity) const
+    {
+        return entity < (entity_id_t)_isBroken.size() && _isBroken[entity];
+    }
 
-            
-            while (true)
-            {
-                float distanceLowWall = LOW_WALL_Y - (position->getPosition().y + collideable->_widthPos.y);
+    void Break (entity_id_t entity)
+    {
+        if (entity >= (entity_id_t)_isBroken.size())
+            _isBroken.resize(entity + 1, 0);
+        _isBroken[entity] = 1;
+        _broken.push_back(entity);
+    }
 
-                if (distanceLowWall < - FLOAT_PRECISION)
-                {
-                    if (IncremCollisions_DestroyIfNeeded(*bouncing)) 
-                        break;
-                    else
-                    {
-                        position->setPosition (position->getPosition().x, position->getPosition().y + distanceLowWall * (1 + bouncing->_bouncing));
-                        MovingComponent* moving = componentManager.GetComponent<MovingComponent>(entityId);
-                        //moving->_speed.x *= bouncing->_bouncing; TODO: add horizontal bouncing
-                        moving->_speed.y *= -bouncing->_bouncing;
-                    }
-                }
+    void Resolve (const Contact& contact)
+    {
+        if (IsBroken(contact._first) || IsBroken(contact._second))
+            return;
 
-                else
-                {
-                    float distanceHighWall = HIGH_WALL_Y - (position->getPosition().y - collideable->_widthNeg.y);
+        CollideableComponent* first  = CollisionSystem::Find<CollideableComponent>(_componentManager, contact._first),
+                            * second = CollisionSystem::Find<CollideableComponent>(_componentManager, contact._second);
+        float time;
+        if (!(first && second) || !first->CanTouch(*second) || !CollisionSystem::Touch(_componentManager, contact._first, contact._second, time))
+            return;
 
-                    if (distanceHighWall > FLOAT_PRECISION)
-                    {
-                        if (IncremCollisions_DestroyIfNeeded(*bouncing)) 
-                            break;
-                        else
-                        {
-                            position->setPosition (position->getPosition().x, position->getPosition().y + distanceHighWall * (1 + bouncing->_bouncing));
-                            MovingComponent* moving = componentManager.GetComponent<MovingComponent>(entityId);
-                            //moving->_speed.x *= bouncing->_bouncing;
-                            moving->_speed.y *= -bouncing->_bouncing;
-                        }
-                    }
+        uint32_t layers = first->_layer | second->_layer;
+        entity_id_t cannonball = first->_layer == LAYER_CANNONBALL ? contact._first : contact._second;
 
-                    else
-                        break;
-                }
+        if (layers == (LAYER_PLAYER | LAYER_CANNONBALL))
+        {
+            _LOG("EVENT: Cannonball %d collided w/ player at %.2f of the step\n", cannonball, time);
+            _eventManager.SendEvent<EntityHurt>();
+            Break(cannonball);
+        }
+        else if (layers == LAYER_CANNONBALL)
+        {
+            Break(contact._first);
+            Break(contact._second);
+        }
+        else if (layers == (LAYER_TURRET | LAYER_CANNONBALL))
+        {
+            Break(cannonball);
+        }
+    }
 
-                
-            }
+public:
 
+    ImpactSystem (World& world):
+        System(world)
+    {
+        _updateInterval = FRAMERATE;
+        Receives<Contacts>();
+        Sends<EntityHurt>();
+        EventDriven();
+        Writes<PositionComponent, OrientationComponent, DrawingComponent, MovingComponent,     // destroys cannonballs
+               BouncingComponent, CollideableComponent, DeadlyComponent, FastMoverComponent>();
+        ChangesStructure();
+    }
+
+    virtual ~ImpactSystem() {}
+
+    virtual float Update() override
+    {
+        _broken.clear();
+
+        int size = this->_raisedEvents.size();
+        for (int i = 0; i < size; i++)
+        {
+            Contacts* event = static_cast<Contacts*> (_eventManager.GetEvent(this->_raisedEvents[i]));
+            for (const Contact& contact : event->_contacts)
+                Resolve(contact);
+
+            _eventManager.EventHandled(this->_raisedEvents[i], *this);
         }
+        this->_raisedEvents.clear();
 
-        return 0;
+        _entityManager.DestroyEntityObjects(_broken);
+        for (entity_id_t entity : _broken)
+            _isBroken[entity] = 0;
 
+        return 0;
     }
 };
 
 class HealthSystem: public System<HealthSystem>, public IEventListener //EntityHurt, GameStarted, GameOver
 {
     entity_id_t playerId;
+    bool _withGraphics;
+    sf::Texture _playerTexture;     // outlives the player, so a render snapshot never points to a freed texture
 
     void HandleEntityHurt (EntityHurt* event)
     {
 
-        HealthComponent* health = componentManager.GetComponent<HealthComponent>(playerId);
+        HealthComponent* health = _componentManager.GetComponent<HealthComponent>(playerId);
 
         health->_hp -= 1;
         _LOG("Player hurt: hp is %d\n", health->_hp);
@@ -712,7 +1171,7 @@ class HealthSystem: public System<HealthSystem>, public IEventListener //EntityH
         if (health->_hp == 0)
         {
             _LOG("EVENT: PlayerDied, %d\n", playerId);
-            eventManager.SendEvent<PlayerDied>(playerId); //TODO: ShootingSystem срабатывает сразу после этого и удаляет Cannonballs
+            _eventManager.SendEvent<PlayerDied>(playerId); //TODO: ShootingSystem срабатывает сразу после этого и удаляет Cannonballs
             //здесь было то, что сейас в хандлгеймовер
         }
     }
@@ -721,7 +1180,7 @@ class HealthSystem: public System<HealthSystem>, public IEventListener //EntityH
     {
         _LOG("Destroying player...\n");
         _LOG("Destroying called from line %d\n", __LINE__);
-        entityManager.DestroyEntityObject(playerId);
+        _entityManager.DestroyEntityObject(playerId);
         _LOG("Done!\n");
         playerId = -1;
     }
@@ -729,32 +1188,46 @@ class HealthSystem: public System<HealthSystem>, public IEventListener //EntityH
     void HandleGameStarted (GameStarted* event)
     {
         _LOG("Creating player... \n");
-        playerId = entityManager.CreateEntityObject<Player>();
+        playerId = _entityManager.CreateEntityObject<Player>();
         _LOG("Adding Health... \n");
-        componentManager.AddComponent<HealthComponent>(playerId, 5);
+        _componentManager.AddComponent<HealthComponent>(playerId, 5);
         _LOG("Adding Position...\n");
-        auto position = componentManager.AddComponent<PositionComponent>(playerId, 0.f, (LOW_WALL_Y + HIGH_WALL_Y) / 2);
+        auto position = _componentManager.AddComponent<PositionComponent>(playerId, 0.f, (LOW_WALL_Y + HIGH_WALL_Y) / 2);
         _LOG("Adding Orientation... \n");
-        auto orientation = componentManager.AddComponent<OrientationComponent>(playerId, 0);
+        auto orientation = _componentManager.AddComponent<OrientationComponent>(playerId, 0);
         _LOG("Adding Moving... \n");
-        componentManager.AddComponent<MovingComponent>(playerId, 0.f, 0.f, position);
+        _componentManager.AddComponent<MovingComponent>(playerId, 0.f, 0.f, position);
         _LOG("Adding Collideable... \n");
-        componentManager.AddComponent<CollideableComponent>(playerId, 30.f, 0.f, 30.f, 0.f);
+        _componentManager.AddComponent<CollideableComponent>(playerId, 30.f, 0.f, 30.f, 0.f, LAYER_PLAYER, LAYER_CANNONBALL);
         _LOG("Adding Bouncing... \n");
-        componentManager.AddComponent<BouncingComponent>(playerId, 0.f, 0);
-        _LOG("Adding Drawing...");
-        componentManager.AddComponent<DrawingComponent>(playerId, "media/player.png", position, orientation);
+        _componentManager.AddComponent<BouncingComponent>(playerId, 0.f, 0);
+        if (_withGraphics)
+        {
+            _LOG("Adding Drawing...");
+            _componentManager.AddComponent<DrawingComponent>(playerId, &_playerTexture, position, orientation);
+        }
         _LOG("Done! id of player=%d\n", playerId);
-        eventManager.SendEvent<PlayerSpawned>(playerId);
+        _eventManager.SendEvent<PlayerSpawned>(playerId);
 
     }
     
     
 public:
 
-    HealthSystem()
+    HealthSystem (World& world, bool withGraphics):
+        System(world),
+        _withGraphics (withGraphics),
+        _playerTexture ()
     {
         _updateInterval = FRAMERATE / 2;
+        if (_withGraphics)
+            _playerTexture.loadFromFile("media/player.png");
+        Receives<EntityHurt, GameStarted, GameOver>();
+        Sends<PlayerDied, PlayerSpawned>();
+        Writes<HealthComponent, PositionComponent, OrientationComponent, MovingComponent,     // creates player
+               CollideableComponent, BouncingComponent, DrawingComponent>();
+        ChangesStructure();
+        EventDriven();
     }
     
     virtual ~HealthSystem() {}
@@ -768,7 +1241,7 @@ public:
             this->_raisedEvents.pop_back();
 
             //EntityHurt* event = dynamic_cast<EntityHurt*> (eventManager.GetEvent(eventId));
-            IEvent* event = eventManager.GetEvent(eventId);
+            IEvent* event = _eventManager.GetEvent(eventId);
             if (event->_eventTypeId == Event<EntityHurt>::EVENT_TYPE_ID)
                 HandleEntityHurt(dynamic_cast<EntityHurt*> (event));
             else if (event->_eventTypeId == Event<GameStarted>::EVENT_TYPE_ID)
@@ -779,7 +1252,7 @@ public:
                 _LOG("ERROR in HealthSystem: unknown event type %d\n", event->_eventTypeId);
             
 
-            eventManager.EventHandled(eventId, *this);
+            _eventManager.EventHandled(eventId, *this);
 
         }
         
@@ -788,7 +1261,7 @@ public:
 
 };
 
-class GameStateSystem: public System<GameStateSystem>, public IEventListener //PlayerDied, PlayerSpawned, EnterPressed, PausedOrResumed
+class GameStateSystem: public CoroutineSystem<GameStateSystem> //PlayerDied, PlayerSpawned, EnterPressed, PausedOrResumed
 {
     int _playersAlive;
     bool _onPause;
@@ -797,7 +1270,7 @@ class GameStateSystem: public System<GameStateSystem>, public IEventListener //P
     inline void HandleGameOver()
     {
         _LOG("EVENT: GameOver\n")
-        eventManager.SendEvent<GameOver>();
+        _eventManager.SendEvent<GameOver>();
         _onPause = false;
         _onGame = false;
     }
@@ -805,24 +1278,24 @@ class GameStateSystem: public System<GameStateSystem>, public IEventListener //P
     
 public:
 
-    GameStateSystem():
+    GameStateSystem (World& world):
+        CoroutineSystem(world),
         _playersAlive(0),
         _onPause(false),
         _onGame(false)
     {
-        _updateInterval = FRAMERATE / 2;
+        Receives<PlayerSpawned, PlayerDied, EnterPressed, PausedOrResumed>();
+        Sends<GameOver, GameStarted, GamePaused, GameResumed>();
     }
 
     virtual ~GameStateSystem() {}
 
-    virtual float Update() override
+    virtual SystemTask Run() override
     {
-        int size = this->_raisedEvents.size();
-        for (int i = 0; size > i; i++)
+        while (true)
         {
-            id_t eventId = this->_raisedEvents[i];
+            IEvent* event = co_await events.Next<PlayerSpawned, PlayerDied, EnterPressed, PausedOrResumed>();
 
-            IEvent* event = eventManager.GetEvent(eventId);
             if (event->_eventTypeId == Event<PlayerSpawned>::EVENT_TYPE_ID)
             {
                 ++(this->_playersAlive);
@@ -839,7 +1312,14 @@ public:
 
             else if (event->_eventTypeId == Event<PausedOrResumed>::EVENT_TYPE_ID)
             {
-                if (this->_onGame) this->_onPause ^= 1;
+                if (this->_onGame)
+                {
+                    this->_onPause ^= 1;
+                    if (this->_onPause)
+                        _eventManager.SendEvent<GamePaused>();
+                    else
+                        _eventManager.SendEvent<GameResumed>();
+                }
             }
 
             else if (event->_eventTypeId == Event<EnterPressed>::EVENT_TYPE_ID)
@@ -851,25 +1331,14 @@ public:
 
                 else if (!this->_onGame)
                 {
-                    eventManager.SendEvent<GameStarted>();
+                    _eventManager.SendEvent<GameStarted>();
                     this->_onPause = false;
                     this->_onGame = true;
                 }
             }
 
-            else 
-                _LOG("ERROR in GameOverSystem: unknown event %d\n", event->_eventTypeId);
-
-            eventManager.EventHandled(eventId, *this);
-
-
+            assert (this->_playersAlive >= 0);
         }
-        this->_raisedEvents.clear();
-
-        assert (this->_playersAlive >= 0);
-
-        return 0;
-
     }
 
 };
@@ -889,128 +1358,377 @@ class UserInputSystem: public System<UserInputSystem>
             default: return -1;
         }
     }
-    
-public:
-
-    UserInputSystem (sf::RenderWindow* window):
-        _window(window)
-    {
-        _updateInterval = FRAMERATE;
-    }
 
-    virtual ~UserInputSystem() {}
-
-    virtual float Update() override
+    void HandleEvent (const sf::Event& event)
     {
-        static sf::Event event;
+        switch (event.type)
+        {
+            case sf::Event::Closed:
+                {
+                    _LOG("EVENT: ExitGame\n"); 
+                    _eventManager.SendEvent<ExitGame>();
+                    break;
+                }
 
-        while (_window->pollEvent(event))
-            switch (event.type)
-            {
-                case sf::Event::Closed:
+            case sf::Event::KeyPressed:
+                {
+                    int wasd = GetWASDMovement(event.key.code);
+                    if (wasd != -1)
                     {
-                        _LOG("EVENT: ExitGame\n"); 
-                        eventManager.SendEvent<ExitGame>();
+                        _eventManager.SendEvent<MovementKeyDown>(wasd);
                         break;
                     }
-
-                case sf::Event::KeyPressed:
+                    if (event.key.code == sf::Keyboard::Escape)
                     {
-                        int wasd = GetWASDMovement(event.key.code);
-                        if (wasd != -1)
-                        {
-                            eventManager.SendEvent<MovementKeyDown>(wasd);
-                            break;
-                        }
-                        if (event.key.code == sf::Keyboard::Escape)
-                        {
-                            eventManager.SendEvent<PausedOrResumed>();
-                            break;
-                        }
-                        if (event.key.code == sf::Keyboard::Enter)
-                        {
-                            eventManager.SendEvent<EnterPressed>();
-                            break;
-                        }
+                        _eventManager.SendEvent<PausedOrResumed>();
                         break;
                     }
-                
-                case sf::Event::KeyReleased:
+                    if (event.key.code == sf::Keyboard::Enter)
                     {
-                        int wasd = GetWASDMovement(event.key.code);
-                        if (wasd != -1)
-                        {
-                            eventManager.SendEvent<MovementKeyUp>(wasd);
-                            break;
-                        }
+                        _eventManager.SendEvent<EnterPressed>();
                         break;
                     }
+                    break;
+                }
+            
+            case sf::Event::KeyReleased:
+                {
+                    int wasd = GetWASDMovement(event.key.code);
+                    if (wasd != -1)
+                    {
+                        _eventManager.SendEvent<MovementKeyUp>(wasd);
+                        break;
+                    }
+                    break;
+                }
 
-                //TODO: Resized, Fullscreen
-
-                default:
-                    //Действие, на которое не обращаем внимания
+            case sf::Event::Resized:
+            case sf::Event::GainedFocus:
+                {
+                    // the picture may be lost while nothing is redrawn
+                    _eventManager.SendEvent<WindowExposed>();
                     break;
+                }
 
+            //TODO: Fullscreen
 
-            }
+            default:
+                //Действие, на которое не обращаем внимания
+                break;
+        }
+    }
+    
+public:
 
+    UserInputSystem (World& world, sf::RenderWindow* window):
+        System(world),
+        _window(window)
+    {
+        _updateInterval = FRAMERATE;
+        Sends<ExitGame, MovementKeyDown, MovementKeyUp, PausedOrResumed, EnterPressed, WindowExposed>();
+        RunsOnMainThread();
+    }
+
+    virtual ~UserInputSystem() {}
+
+    virtual float Update() override
+    {
+        static sf::Event event;
+
+        // Every other system is dormant, as in the menu or on pause: nothing will change
+        // till the user does something, so sleep in the window instead of polling it
+        if (_systemManager.GetActiveSystemsCount() == 1 && _window->waitEvent(event))
+            HandleEvent(event);
+
+        while (_window->pollEvent(event))
+            HandleEvent(event);
 
         return 0;
     }
 };
 
+// Replaces UserInputSystem in headless mode: sends input events read from a script.
+// Every line of a script is "<update number> <command> [w|a|s|d]", where command is
+// one of enter, escape, down, up, exit. Lines starting with '#' are ignored
+class ScriptedInputSystem: public System<ScriptedInputSystem>
+{
+    struct ScriptedInput
+    {
+        int _update;
+        char _command[16];
+        int _wasd;
+    };
+
+    std::vector<ScriptedInput> _script;
+    int _nextInput;
+    int _updatesCount;
+
+    static int GetWASD (char key)
+    {
+        switch (key)
+        {
+            case 'w': return 0;
+            case 'a': return 1;
+            case 's': return 2;
+            case 'd': return 3;
+            default: return -1;
+        }
+    }
+
+    void AddInput (int update, const char* command, char key)
+    {
+        ScriptedInput input = {};
+        input._update = update;
+        strncpy(input._command, command, sizeof(input._command) - 1);
+        input._wasd = GetWASD(key);
+        _script.push_back(input);
+    }
+
+public:
+
+    // Starts the game, holds D and exits after 10 minutes of game time
+    static constexpr const char* DEFAULT_SCRIPT = nullptr;
+    static const int DEFAULT_SCRIPT_UPDATES = 10 * 60 * FPS;
+
+    ScriptedInputSystem (World& world):
+        System(world),
+        _nextInput(0),
+        _updatesCount(0)
+    {
+        _updateInterval = FRAMERATE;
+        Sends<ExitGame, MovementKeyDown, MovementKeyUp, PausedOrResumed, EnterPressed>();
+    }
+
+    virtual ~ScriptedInputSystem() {}
+
+    bool LoadScript (const char* filename)
+    {
+        _script.clear();
+        _nextInput = 0;
+
+        if (filename == DEFAULT_SCRIPT)
+        {
+            AddInput(0, "enter", 0);
+            AddInput(1, "down", 'd');
+            AddInput(DEFAULT_SCRIPT_UPDATES, "exit", 0);
+            return true;
+        }
+
+        FILE* script = fopen(filename, "r");
+        if (!script)
+            return false;
+
+        char line[128] = "";
+        while (fgets(line, sizeof(line), script))
+        {
+            int update = 0;
+            char command[16] = "";
+            char key = 0;
+            if (line[0] == '#' || sscanf(line, "%d %15s %c", &update, command, &key) < 2)
+                continue;
+            AddInput(update, command, key);
+        }
+        fclose(script);
+
+        std::stable_sort(_script.begin(), _script.end(),
+                         [] (const ScriptedInput& lhs, const ScriptedInput& rhs) { return lhs._update < rhs._update; });
+        return true;
+    }
+
+    virtual float Update() override
+    {
+        int scriptSize = _script.size();
+        for (; _nextInput < scriptSize && _script[_nextInput]._update <= _updatesCount; _nextInput++)
+        {
+            const ScriptedInput& input = _script[_nextInput];
+
+            if (!strcmp(input._command, "enter"))
+                _eventManager.SendEvent<EnterPressed>();
+            else if (!strcmp(input._command, "escape"))
+                _eventManager.SendEvent<PausedOrResumed>();
+            else if (!strcmp(input._command, "exit"))
+                _eventManager.SendEvent<ExitGame>();
+            else if (!strcmp(input._command, "down") && input._wasd != -1)
+                _eventManager.SendEvent<MovementKeyDown>(input._wasd);
+            else if (!strcmp(input._command, "up") && input._wasd != -1)
+                _eventManager.SendEvent<MovementKeyUp>(input._wasd);
+            else
+                _LOG("ERROR in ScriptedInputSystem: bad input \"%s\" at update %d\n", input._command, input._update);
+        }
+
+        _updatesCount++;
+        return 0;
+    }
+};
+
 //TODO: интервал обновления. Передаётся в качестве параметра systemManager у и в нём же хранится
 
-class RenderSystem: public System<RenderSystem>, public IEventListener //GameStarted, GameOver, PausedOrResumed, PlayerSpawned, PlayerDied
+// A background of tile rows that repeat along x. The tiles are cut from one atlas texture,
+// so all the ones in view go in one vertex array and take one draw call. The array is built
+// anew only when the camera crosses a tile boundary, rebasing included; in between it is
+// drawn where it is, moved by the camera's offset
+class TileMap
+{
+    float _tileSize;
+    float _top;                         // of the first row
+    int _columnsCount;                  // enough to cover the view at any offset
+    sf::Texture _atlas;
+    sf::Vector2u _tileTextureSize;
+    std::vector<int> _rows;             // tile of each row, from the top
+    sf::VertexArray _vertices;          // quads in the coordinates of the world
+    int64_t _firstColumn;               // the column _vertices begin with, INT64_MIN till they are built
+
+    void Build (int64_t firstColumn)
+    {
+        PROFILE_ZONE("TileMap::Build", "render")
+        const sf::Vector2f corners[4] = { {0.f, 0.f}, {1.f, 0.f}, {1.f, 1.f}, {0.f, 1.f} };
+
+        _vertices.resize(_rows.size() * _columnsCount * 4);
+        size_t vertex = 0;
+        for (size_t row = 0; row < _rows.size(); row++)
+            for (int column = 0; column < _columnsCount; column++)
+            {
+                float left = (float)((firstColumn + column) * _tileSize);
+                float top = _top + row * _tileSize;
+                float textureLeft = (float)(_rows[row] * _tileTextureSize.x);
+
+                for (const sf::Vector2f& corner : corners)
+                {
+                    _vertices[vertex].position = sf::Vector2f(left + corner.x * _tileSize, top + corner.y * _tileSize);
+                    _vertices[vertex].texCoords = sf::Vector2f(textureLeft + corner.x * _tileTextureSize.x, corner.y * _tileTextureSize.y);
+                    vertex++;
+                }
+            }
+        _firstColumn = firstColumn;
+    }
+
+public:
+
+    TileMap (float tileSize, float top, int viewWidth):
+        _tileSize (tileSize),
+        _top (top),
+        _columnsCount (viewWidth / (int)tileSize + 2),
+        _atlas(),
+        _tileTextureSize (0, 0),
+        _firstColumn (INT64_MIN)
+    {
+        _vertices.setPrimitiveType(sf::Quads);
+    }
+
+    // Tile i is files[i]; they are put side by side in the atlas, so all must be the same size
+    bool LoadTiles (const std::vector<const char*>& files)
+    {
+        std::vector<sf::Image> images (files.size());
+        for (size_t i = 0; i < files.size(); i++)
+            if (!images[i].loadFromFile(files[i]))
+                return false;
+        if (images.empty())
+            return false;
+
+        _tileTextureSize = images[0].getSize();
+        sf::Image atlas;
+        atlas.create(_tileTextureSize.x * images.size(), _tileTextureSize.y);
+        for (size_t i = 0; i < images.size(); i++)
+            atlas.copy(images[i], _tileTextureSize.x * i, 0);
+
+        _firstColumn = INT64_MIN;
+        return _atlas.loadFromImage(atlas);
+    }
+
+    void AddRow (int tile)
+    {
+        _rows.push_back(tile);
+        _firstColumn = INT64_MIN;
+    }
+
+    // camera: the world position of the view's top left corner
+    void Draw (sf::RenderWindow& window, const sf::Vector2f& camera)
+    {
+        int64_t firstColumn = (int64_t)std::floor(camera.x / _tileSize);
+        if (firstColumn != _firstColumn)
+            Build(firstColumn);
+
+        // whole pixels along x, so the tiles don't shimmer as the camera goes
+        sf::RenderStates states (&_atlas);
+        states.transform.translate(-std::floor(camera.x), -camera.y);
+        window.draw(_vertices, states);
+    }
+};
+
+// What RenderSystem draws: filled at the end of a simulation frame, drawn by the render thread
+struct RenderSnapshot
+{
+    struct SpriteState
+    {
+        const sf::Texture* _texture;        // nullptr for empty slots
+        sf::Vector2f _position;             // on screen
+        sf::Vector2f _origin;
+        float _rotation;
+    };
+
+    bool _onGame;
+    bool _onPause;
+    sf::Vector2f _cameraPosition;
+    int _score;
+    int _hp;
+    std::vector<SpriteState> _sprites;
+};
+
+class RenderSystem: public System<RenderSystem>, public IEventListener //GameStarted, GameOver, GamePaused, GameResumed, PlayerSpawned, PlayerDied, WindowExposed
 {
     bool _onGame;
     bool _onPause;
     entity_id_t _playerId;
-    sf::Sprite _brickSprite;
-    sf::Texture _brickTexture;
-    sf::Sprite _wallSprite;
-    sf::Texture _wallTexture;
+    int _score;
+
+    // Everything below is used only by the thread that draws
+    TileMap _background;                    // walls and bricks
     sf::Texture _pauseTexture;
     sf::Sprite _pauseSprite;
     sf::Texture _mainmenuTexture;
     sf::Sprite _mainmenuSprite;
     sf::Texture _levelTexture;
     sf::Sprite _levelSprite;
+    sf::Sprite _entitySprite;
     sf::RenderWindow *_window;
     sf::Text _score_hp;
     sf::Font _font;
     char _str_score_hp [24];
-    int _score;
+
+    // Pipelined mode: the simulation publishes snapshots, _renderThread draws the latest one
+    bool _pipelined;
+    TripleBuffer<RenderSnapshot> _snapshots;
+    std::thread _renderThread;
+    std::atomic<bool> _rendering;
+    std::mutex _publishedMutex;
+    std::condition_variable _published;
 
     const char* FONT_FILE = "media/arial.ttf";
+    const int CULLING_MARGIN = 4 * 30;      // sprites reach past their positions, and interpolation moves them back
+
+    std::vector<entity_id_t> _visible;
 
-    void PrepareString (int hp)
+    void PrepareString (int score, int hp)
     {
         int digits = 0;
-        sprintf(_str_score_hp + 7, "%d%n", _score, &digits);
+        sprintf(_str_score_hp + 7, "\t\t\t\t\t\t\t\t\t");
+        _str_score_hp[16] = '\n';
+        sprintf(_str_score_hp + 7, "%d%n", score, &digits);
         _str_score_hp[7 + digits] = ' ';
         sprintf(_str_score_hp + 21, "%d", hp);
     }
 
 
-    float getDelta (float cameraPos)
-    {
-        return -((int)cameraPos % 30);
-    }
-
     void CheckEvents()
     {
         int size = this->_raisedEvents.size();
         for (int i = 0; i < size; i++)
         {
-            IEvent* event = eventManager.GetEvent(this->_raisedEvents[i]);
+            IEvent* event = _eventManager.GetEvent(this->_raisedEvents[i]);
             if (event->_eventTypeId == Event<GameStarted>::EVENT_TYPE_ID)
             {
                 _onGame = true;
                 _score = 0;
-                sprintf(_str_score_hp + 7, "\t\t\t\t\t\t\t\t\t");
-                _str_score_hp[16] = '\n';
             }
             else if (event->_eventTypeId == Event<GameOver>::EVENT_TYPE_ID)
             {
@@ -1018,10 +1736,17 @@ class RenderSystem: public System<RenderSystem>, public IEventListener //GameSta
                 _onPause = false;
                 _playerId = -1;
             }
-            else if (event->_eventTypeId == Event<PausedOrResumed>::EVENT_TYPE_ID)
+            else if (event->_eventTypeId == Event<GamePaused>::EVENT_TYPE_ID)
+            {
+                _onPause = true;
+            }
+            else if (event->_eventTypeId == Event<GameResumed>::EVENT_TYPE_ID)
+            {
+                _onPause = false;
+            }
+            else if (event->_eventTypeId == Event<WindowExposed>::EVENT_TYPE_ID)
             {
-                if (_onGame)
-                    _onPause = !_onPause;
+                // only has to redraw
             }
             else if (event->_eventTypeId == Event<PlayerSpawned>::EVENT_TYPE_ID)
             {
@@ -1037,37 +1762,157 @@ class RenderSystem: public System<RenderSystem>, public IEventListener //GameSta
                 _LOG( "ERROR in RenderSystem: unknown event %d\n", event->_eventTypeId);
             }
 
-            eventManager.EventHandled(this->_raisedEvents[i], *this);
+            _eventManager.EventHandled(this->_raisedEvents[i], *this);
         }
         this->_raisedEvents.clear();
     }
 
+    void FillSnapshot (RenderSnapshot& snapshot)
+    {
+        PROFILE_ZONE("FillSnapshot", "render")
+        // between the last two MovingSystem states when it runs with a fixed step, the last state otherwise
+        float fraction = _systemManager.GetStepFraction<MovingSystem>(_worldClock.Now_nsec());
+
+        sf::Vector2f cameraPosition = 
+            _playerId == -1 ? 
+            sf::Vector2f(0.f, 0.f) : 
+            _componentManager.GetComponent<PositionComponent>(this->_playerId)->getInterpolatedPosition(fraction) + sf::Vector2f (-WINDOW_X / 2, -WINDOW_Y / 2);
+
+        double cameraX = _worldOrigin.ToAbsolute(cameraPosition.x);
+        if (_onGame && cameraX > _score)
+            _score = cameraX;
+
+        snapshot._onGame = _onGame;
+        snapshot._onPause = _onPause;
+        snapshot._cameraPosition = cameraPosition;
+        snapshot._score = _score;
+        snapshot._hp = _playerId == -1 ? 0 : _componentManager.GetComponent<HealthComponent>(_playerId)->_hp;
+
+        // only what is in view; one slot per visible entity, so the slots are filled in parallel and keep entity order
+        _visible.clear();
+        _spatialGrid.QueryAABB(cameraPosition.x - CULLING_MARGIN, cameraPosition.y - CULLING_MARGIN,
+                               cameraPosition.x + WINDOW_X + CULLING_MARGIN, cameraPosition.y + WINDOW_Y + CULLING_MARGIN, _visible);
+        std::sort(_visible.begin(), _visible.end());
+
+        const std::vector<IComponent*>& drawingComponents = _componentManager.GetEntitiesVector<DrawingComponent>();
+        int drawingCount = drawingComponents.size();
+        snapshot._sprites.resize(_visible.size());
+        jobSystem.ParallelFor(0, (int)_visible.size(), [this, &drawingComponents, drawingCount, &snapshot, cameraPosition, fraction] (int i)
+        {
+            RenderSnapshot::SpriteState& state = snapshot._sprites[i];
+            entity_id_t entity = _visible[i];
+            if (entity >= drawingCount || drawingComponents[entity] == nullptr)
+            {
+                state._texture = nullptr;
+                return;
+            }
+
+            DrawingComponent& drawing = *static_cast<DrawingComponent*>(drawingComponents[entity]);
+            state._texture = drawing._sprite.getTexture();
+            state._position = drawing._position->getInterpolatedPosition(fraction) - cameraPosition;
+            state._origin = drawing._sprite.getOrigin();
+            state._rotation = drawing._sprite.getRotation();
+        });
+    }
+
+    void Draw (const RenderSnapshot& snapshot)
+    {
+        PROFILE_ZONE("Draw", "render")
+        sf::RenderWindow& thisWindow = *(this->_window);
+        const sf::Vector2f& cameraPosition = snapshot._cameraPosition;
+
+        thisWindow.clear();
+        if (snapshot._onGame)
+        {
+            // Нарисовать стены
+            _background.Draw(thisWindow, cameraPosition);
+
+
+
+            PrepareString(snapshot._score, snapshot._hp);
+
+            _score_hp.setString(sf::String(_str_score_hp));
+            thisWindow.draw(_score_hp);
+
+        }
+
+        else
+        {
+            thisWindow.draw(_score_hp);   
+            thisWindow.draw (this->_mainmenuSprite);
+        }
+
+
+
+        // Нарисовать entities
+
+        for (const RenderSnapshot::SpriteState& state : snapshot._sprites)
+        {
+            if (state._texture == nullptr || state._position.y >= WINDOW_Y) continue;
+
+            _entitySprite.setTexture(*state._texture, true);
+            _entitySprite.setOrigin(state._origin);
+            _entitySprite.setRotation(state._rotation);
+            _entitySprite.setPosition(state._position);
+            thisWindow.draw (_entitySprite);
+        }
+
+
+
+        if (snapshot._onPause)
+        {
+            assert(snapshot._onGame);
+            this->_window->draw (this->_pauseSprite);
+        }
+
+
+
+
+        _window->display(); 
+    }
+
+    void RenderLoop()
+    {
+        _window->setActive(true);
+        while (_rendering)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_publishedMutex);
+                _published.wait(lock, [this] { return !_rendering || _snapshots.HasFresh(); });
+            }
+            if (_snapshots.Acquire())
+                Draw(_snapshots.GetFront());
+        }
+        _window->setActive(false);
+    }
+
 public:
 
     inline sf::RenderWindow* GetWindow() { return (this->_window); }
 
-    RenderSystem ():
+    // pipelined: draw on a separate thread, the simulation goes on with the next frame meanwhile
+    RenderSystem (World& world, bool pipelined):
+        System(world),
         _onGame(false),
         _onPause(false),
         _playerId(-1),
-        _brickTexture(),
-        _brickSprite(),
-        _wallTexture(),
-        _wallSprite(),
+        _score(0),
+        _background(TILE_SIZE, HIGH_WALL_Y - 4 * TILE_SIZE, WINDOW_X),
         _pauseTexture(),
         _pauseSprite(),
         _levelTexture(),
-        _levelSprite()
+        _levelSprite(),
+        _entitySprite(),
+        _pipelined(pipelined),
+        _rendering(false)
         
     {
         _window = new sf::RenderWindow (sf::VideoMode(WINDOW_X, WINDOW_Y), "XEPOB ETG", sf::Style::Default);
-        _wallTexture.loadFromFile("media/wall.png");
-        _wallSprite.setTexture(_wallTexture);
-        _wallSprite.setScale(3, 3);
-
-        _brickTexture.loadFromFile("media/brick.png");
-        _brickSprite.setTexture(_brickTexture);
-        _brickSprite.setScale(3, 3);
+        // bricks above and below the walls, 4 rows each
+        const int BRICK = 0, WALL = 1;
+        _background.LoadTiles({ "media/brick.png", "media/wall.png" });
+        for (int y = HIGH_WALL_Y - 4 * TILE_SIZE; y < LOW_WALL_Y + 4 * TILE_SIZE; y += TILE_SIZE)
+            _background.AddRow(y < HIGH_WALL_Y || y >= LOW_WALL_Y ? BRICK : WALL);
 
         _levelTexture.loadFromFile("media/level.png");
         _levelSprite.setTexture(_levelTexture);
@@ -1093,199 +1938,365 @@ public:
         _window->setKeyRepeatEnabled(false);
 
         _updateInterval = FRAMERATE;
+        Receives<GameStarted, GameOver, GamePaused, GameResumed, PlayerSpawned, PlayerDied, WindowExposed>();
+        Reads<PositionComponent, HealthComponent, DrawingComponent>();
+        WakesOnChangeOf<DrawingComponent>();
 
+        if (_pipelined)
+        {
+            // the window stays on this thread for events, its GL context moves to the render thread
+            _window->setActive(false);
+            _rendering = true;
+            _renderThread = std::thread(&RenderSystem::RenderLoop, this);
+        }
+        else
+            RunsOnMainThread();
+
+    }
+
+    // Textures in snapshots belong to other systems, so it's called before they are deleted
+    void StopRendering()
+    {
+        if (!_renderThread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(_publishedMutex);
+            _rendering = false;
+        }
+        _published.notify_one();
+        _renderThread.join();
     }
 
     virtual ~RenderSystem() 
     {
+        StopRendering();
         delete _window;
     }
 
     virtual float Update() override
     {
-        sf::RenderWindow& thisWindow = *(this->_window);
         CheckEvents();
-        sf::Vector2f cameraPosition = 
-            _playerId == -1 ? 
-            sf::Vector2f(0.f, 0.f) : 
-            componentManager.GetComponent<PositionComponent>(this->_playerId)->getPosition() + sf::Vector2f (-WINDOW_X / 2, -WINDOW_Y / 2);
+        FillSnapshot(_snapshots.GetBack());
 
-        thisWindow.clear();
-        if (_onGame)
+        if (!_pipelined)
+            Draw(_snapshots.GetBack());
+        else
         {
-            //this->_levelSprite.setPosition(getDelta(cameraPosition.x) - 30, HIGH_WALL_Y);
-            //this->_window.draw(this->_levelSprite);
-            // Нарисовать стены
-            float y0, x0, y0_end = HIGH_WALL_Y - cameraPosition.y;
-
-            for (y0 = HIGH_WALL_Y - cameraPosition.y - 4 * 30; y0 < y0_end; y0 += 30)
-                for (x0 = getDelta(cameraPosition.x) - 30; x0 < WINDOW_X; x0 += 30)
-                {
-                    this->_brickSprite.setPosition(x0, y0);
-                    thisWindow.draw (this->_brickSprite);
-                }
-            y0_end = LOW_WALL_Y - cameraPosition.y;
-            for (; y0 < y0_end; y0 += 30)
-                for (x0 = getDelta(cameraPosition.x) - 30; x0 < WINDOW_X; x0 += 30)
-                {
-                    this->_wallSprite.setPosition(x0, y0);
-                    thisWindow.draw (this->_wallSprite);
-                }
-            y0_end = LOW_WALL_Y + 4 * 30 - cameraPosition.y;
-            for (; y0 < y0_end; y0 += 30)
-                for (x0 = getDelta(cameraPosition.x) - 30; x0 < WINDOW_X; x0 += 30)
-                {
-                    this->_brickSprite.setPosition(x0, y0);
-                    thisWindow.draw (this->_brickSprite);
-                }
-
-
-
-            if (cameraPosition.x > _score)
-                _score = cameraPosition.x;
+            _snapshots.Publish();
+            {
+                std::lock_guard<std::mutex> lock(_publishedMutex);
+            }
+            _published.notify_one();
+        }
 
-            PrepareString(_playerId == -1 ? 0 : componentManager.GetComponent<HealthComponent>(_playerId)->_hp);
+        // In the menu and on pause nothing moves, so the screen stays the same till
+        // an event or a spawned or destroyed sprite wakes the system up
+        if (!_onGame || _onPause)
+            return INFINITY;
 
-            _score_hp.setString(sf::String(_str_score_hp));
-            thisWindow.draw(_score_hp);
+        return 0;
 
-        }
+    }
+};
+                                                                                                     // 10 * 30 pix
+// Builds the turrets of chunks on its own thread: where they stand and where they aim.
+// Every chunk is built from its own seed, made of the level's seed and the chunk's index
+// in the level, so a chunk comes out the same whenever, wherever and however many times it
+// is built. Entities are made by whoever takes the turrets, on the simulation's thread.
+// Restart() begins a new level; Request() has chunks built ahead, Take() hands over the
+// turrets of a chunk, building them on the spot if they weren't asked for
+class LevelStreamer
+{
+public:
 
-        else
+    struct Turret
+    {
+        int64_t _chunk;                 // of the world's origin
+        float _offsetX;                 // from the start of the chunk
+        float _y;
+        int _angle;
+    };
+
+private:
+
+    static const int64_t NONE = INT64_MIN;
+
+    const float _chunkSize;
+    const float _interval;
+    const float _firstX;                // of the first turrets, from the start of the level
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _requested;
+    std::condition_variable _built;
+    bool _stopping;
+    int _level;                         // restarts so far
+    unsigned _seed;
+    int64_t _levelChunk;                // where the level begins
+    std::deque<int64_t> _queue;         // requested and not built yet
+    int64_t _building;                  // by the builder now, NONE if nothing
+    int _buildingLevel;                 // the level _building is of
+    std::unordered_map<int64_t, std::vector<Turret>> _chunks;   // built and not taken yet
+    std::vector<Turret> _scratch;       // used only by the builder
+
+    // SplitMix64's mixing: neighbouring chunks get unrelated seeds
+    static uint32_t ChunkSeed (unsigned seed, int64_t chunk)
+    {
+        uint64_t z = ((uint64_t)seed << 32) + (uint64_t)chunk + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return (uint32_t)(z ^ (z >> 31));
+    }
+
+    void Build (unsigned seed, int64_t levelChunk, int64_t chunk, std::vector<Turret>& turrets) const
+    {
+        std::minstd_rand random (ChunkSeed(seed, chunk - levelChunk));
+        double chunkX = (double)(chunk - levelChunk) * _chunkSize;       // from the start of the level
+        double x = chunkX < _firstX ? _firstX : _firstX + std::ceil((chunkX - _firstX) / _interval) * _interval;
+        for (; x < chunkX + _chunkSize; x += _interval)
         {
-            thisWindow.draw(_score_hp);   
-            thisWindow.draw (this->_mainmenuSprite);
+            turrets.push_back(Turret { chunk, (float)(x - chunkX), LOW_WALL_Y,
+                                       (int)(random() % (Cannon::MAX_ANGLE - Cannon::MIN_ANGLE + 1)) + Cannon::MIN_ANGLE - 90 });
+            turrets.push_back(Turret { chunk, (float)(x - chunkX), HIGH_WALL_Y,
+                                       (int)(random() % (Cannon::MAX_ANGLE - Cannon::MIN_ANGLE + 1)) + 180 + Cannon::MIN_ANGLE - 90 });
         }
+    }
 
+    // Whether the builder is on chunk of the current level; under _mutex
+    inline bool IsBuilding (int64_t chunk) const
+    {
+        return _building == chunk && _buildingLevel == _level;
+    }
 
-
-        // Нарисовать entities
-
-        std::vector<IComponent*> drawingComponents = componentManager.GetEntitiesVector<DrawingComponent>();
-
-        for (IComponent* drawingCo : drawingComponents)
+    void BuildLoop()
+    {
+        while (true)
         {
-            if (drawingCo == nullptr) continue;
-            register auto drrCo = dynamic_cast<DrawingComponent*>(drawingCo);
-            drrCo->_sprite.setPosition (drrCo->_position->getPosition() - cameraPosition);
+            int64_t chunk, levelChunk;
+            unsigned seed;
+            int level;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _requested.wait(lock, [this] { return _stopping || !_queue.empty(); });
+                if (_stopping)
+                    return;
+                chunk = _building = _queue.front();
+                _queue.pop_front();
+                seed = _seed;
+                levelChunk = _levelChunk;
+                level = _buildingLevel = _level;
+            }
 
-            sf::Sprite& sprite = drrCo->_sprite;
-            if (sprite.getPosition().y < WINDOW_Y)
-                thisWindow.draw (sprite);
+            _scratch.clear();
+            Build(seed, levelChunk, chunk, _scratch);
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _building = NONE;
+                if (level == _level)            // not built for a level that is gone
+                    _chunks[chunk] = _scratch;
+            }
+            _built.notify_all();
         }
+    }
 
+public:
 
+    LevelStreamer (float chunkSize, float interval, float firstX):
+        _chunkSize (chunkSize),
+        _interval (interval),
+        _firstX (firstX),
+        _stopping (false),
+        _level (0),
+        _seed (1),
+        _levelChunk (0),
+        _building (NONE),
+        _buildingLevel (0)
+    {
+        _thread = std::thread(&LevelStreamer::BuildLoop, this);
+    }
 
-        if (_onPause)
+    ~LevelStreamer()
+    {
         {
-            assert(_onGame);
-            this->_window->draw (this->_pauseSprite);
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
         }
+        _requested.notify_one();
+        _thread.join();
+    }
 
+    LevelStreamer (const LevelStreamer&) = delete;
+    LevelStreamer& operator= (const LevelStreamer&) = delete;
 
+    // Drops what was built; the new level begins at levelChunk
+    void Restart (unsigned seed, int64_t levelChunk)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _level++;
+        _seed = seed;
+        _levelChunk = levelChunk;
+        _queue.clear();
+        _chunks.clear();
+    }
 
+    // Chunks [first, last) are built in this order, but the ones already built or on the way
+    void Request (int64_t first, int64_t last)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (int64_t chunk = first; chunk < last; chunk++)
+                if (!IsBuilding(chunk) && _chunks.find(chunk) == _chunks.end()
+                 && std::find(_queue.begin(), _queue.end(), chunk) == _queue.end())
+                    _queue.push_back(chunk);
+        }
+        _requested.notify_one();
+    }
 
-        _window->display(); 
-
+    // Appends the turrets of chunk to turrets, in the order they stand
+    void Take (int64_t chunk, std::vector<Turret>& turrets)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _built.wait(lock, [this, chunk] { return !IsBuilding(chunk); });
 
-        return 0;
+        auto built = _chunks.find(chunk);
+        if (built != _chunks.end())
+        {
+            turrets.insert(turrets.end(), built->second.begin(), built->second.end());
+            _chunks.erase(built);
+            return;
+        }
 
+        auto queued = std::find(_queue.begin(), _queue.end(), chunk);
+        if (queued != _queue.end())
+            _queue.erase(queued);
+        Build(_seed, _levelChunk, chunk, turrets);      // cheaper than waiting for the builder to get to it
     }
 };
-                                                                                                     // 10 * 30 pix
-class LevelGenSystem: public System<LevelGenSystem>, public IEventListener //GameStarted, PlayerPassedChunk, XReduced, GameOver
+
+// Keeps the turrets of the chunks near the player, from the player's chunk as far as the
+// activity region reaches, and a chunk more. At every chunk the player passes the chunks
+// that came near are made, from what LevelStreamer built ahead, and the ones that fell
+// behind destroyed. Chunks are built the same every time, so one that comes near again is
+// the way it was, and the turrets alive don't depend on how far the player went.
+// Chunks are made and destroyed within the system's budget an update, so neither a new
+// game nor the end of one is done in a single frame
+class LevelGenSystem: public System<LevelGenSystem>, public IEventListener //GameStarted, PlayerPassedChunk, GameOver
 {
-    int _left_x;
-    int _right_x;
+    struct ChunkWork
+    {
+        int64_t _chunk;
+        bool _materialize;              // or dematerialize
+    };
+
+    int64_t _firstChunk;                // of _worldOrigin; the chunks [_firstChunk, _lastChunk) have their turrets, or will
+    int64_t _lastChunk;
+    WorkQueue<ChunkWork> _work;
     entity_id_t _playerId;
-    std::deque <entity_id_t> _turrets;
+    EntityGroups<int64_t> _turrets;     // by chunk
+    std::vector<entity_id_t> _erased;
+    std::vector<LevelStreamer::Turret> _batch;
+    unsigned _levelsCount;
     sf::Texture _turretTexture;
+    bool _withGraphics;
 
-    const int WIDE = 500 * 30; //pix
     const int TURRETS_INTERVAL = 10 * 30; //pix
     const int NO_TURRETS_ON_START = 25 * 30;
+    const int MAX_REACH = 250 * 30;     // pix; of the player, whatever the activity region is
+    const int BUILT_AHEAD = 8;          // chunks
+
+    LevelStreamer _streamer;
 
-    entity_id_t GenerateCannon (float x, float y, int minAngle, int maxAngle)
+    entity_id_t GenerateCannon (float x, float y, int angle)
     {
-        entity_id_t cannon = entityManager.CreateEntityObject<Cannon>();
-        PositionComponent* position = componentManager.AddComponent<PositionComponent>(cannon, x, y);
-        OrientationComponent* orientation = componentManager.AddComponent<OrientationComponent>(cannon, rand()%(maxAngle - minAngle + 1) + minAngle - 90);
-        auto drawing = componentManager.AddComponent<DrawingComponent>(cannon, &_turretTexture, position, orientation);
-        drawing->_sprite.setOrigin(15.f, 45.f);
-        componentManager.AddComponent<ShootingComponent>(cannon, position, orientation);
-        this->_turrets.push_back(cannon);
+        entity_id_t cannon = _entityManager.CreateEntityObject<Cannon>();
+        PositionComponent* position = _componentManager.AddComponent<PositionComponent>(cannon, x, y);
+        OrientationComponent* orientation = _componentManager.AddComponent<OrientationComponent>(cannon, angle);
+        if (_withGraphics)
+        {
+            auto drawing = _componentManager.AddComponent<DrawingComponent>(cannon, &_turretTexture, position, orientation);
+            drawing->_sprite.setOrigin(15.f, 45.f);
+        }
+        _componentManager.AddComponent<ShootingComponent>(cannon, position, orientation);
+        _componentManager.AddComponent<CollideableComponent>(cannon, 15.f, 15.f, 15.f, 15.f, LAYER_TURRET, LAYER_CANNONBALL);
         return cannon;
     }
 
-    void GenerateBetween(float x1, float x2)
+    void Materialize (int64_t chunk)
     {
-        for (float x = x1; x < x2; x += TURRETS_INTERVAL)
-        {
-            GenerateCannon(x, LOW_WALL_Y, Cannon::MIN_ANGLE, Cannon::MAX_ANGLE);
-            GenerateCannon(x, HIGH_WALL_Y, 180 + Cannon::MIN_ANGLE, 180 + Cannon::MAX_ANGLE);
-        }
+        _batch.clear();
+        _streamer.Take(chunk, _batch);
+        for (const LevelStreamer::Turret& turret : _batch)
+            _turrets.Add(chunk, GenerateCannon(_worldOrigin.ToFloat(turret._chunk, turret._offsetX), turret._y, turret._angle));
     }
 
-    void EraseTill (float x0)
+    void Dematerialize (int64_t chunk)
     {
-        entity_id_t entity = this->_turrets.front();
-        PositionComponent* pos = componentManager.GetComponent<PositionComponent>(entity);
-        while (true)
-        {
-            entity = this->_turrets.front();
-            pos = componentManager.GetComponent<PositionComponent>(entity);
-            if (pos->getPosition().x > x0)
-                break;
-            _LOG("Destroying called from line %d\n", __LINE__);
-            entityManager.DestroyEntityObject(entity);
-            this->_turrets.pop_front();
-        }
-        
+        _erased.clear();
+        _turrets.Take(chunk, _erased);
+        if (_erased.empty())
+            return;
+        _LOG("Destroying called from line %d\n", __LINE__);
+        _entityManager.DestroyEntityObjects(_erased);
     }
 
-    void HandleGameStarted()
+    // Chunks near x have their turrets, the others don't
+    void MaterializeAround (float x)
     {
-        this->_left_x = - WIDE / 4;
-        this->_right_x = 3 * WIDE / 4;
+        float reach = std::max((float)WINDOW_X, std::min(_activityRegion.GetRadius(), (float)MAX_REACH)) + CHUNK_SIZE;
+        int64_t first, last;
+        float offset;
+        _worldOrigin.ToChunk(x - reach, first, offset);
+        _worldOrigin.ToChunk(x + reach, last, offset);
+        last++;
+
+        for (int64_t chunk = _firstChunk; chunk < _lastChunk; chunk++)
+            if (chunk < first || chunk >= last)
+                _work.Push(ChunkWork { chunk, false });
+        for (int64_t chunk = first; chunk < last; chunk++)
+            if (chunk < _firstChunk || chunk >= _lastChunk)
+                _work.Push(ChunkWork { chunk, true });
+        _firstChunk = first;
+        _lastChunk = last;
 
-        GenerateBetween (NO_TURRETS_ON_START, this->_right_x);
+        _streamer.Request(last, last + BUILT_AHEAD);
+    }
 
+    void DoChunkWork (const ChunkWork& work)
+    {
+        if (work._materialize)
+            Materialize(work._chunk);
+        else
+            Dematerialize(work._chunk);
+    }
+
+    void HandleGameStarted()
+    {
+        // what is left of the last game goes at once
+        _work.Run([this] (const ChunkWork& work) { DoChunkWork(work); });
+
+        // the player starts at 0
+        _streamer.Restart(++_levelsCount, _worldOrigin.GetChunk());     // another level every game
+        MaterializeAround(0.f);
     }
 
     void HandlePlayerPassedChunk()
     {
-        auto playerPos = componentManager.GetComponent<PositionComponent>(this->_playerId);
+        auto playerPos = _componentManager.GetComponent<PositionComponent>(this->_playerId);
         if (playerPos == nullptr)
         {
             _LOG("ERROR in WorldGenSystem: can\'t find player\n");
             return;
         }
 
-        float playerX = playerPos->getPosition().x;
-        if (playerX * 2 >= this->_left_x + this->_right_x)
-        {
-            _LOG("Level updated at position %f\n", playerPos->getPosition().x)
-            GenerateBetween(this->_right_x, playerX + 3 * WIDE / 4);
-            EraseTill(playerX - WIDE / 4);
-            this->_left_x  = playerX - 1 * WIDE / 4;
-            this->_right_x = playerX + 3 * WIDE / 4;
-        }
-    }
-
-    void HandleXReduced()
-    {
-        this->_right_x -= X_DECREASING;
-        this->_left_x  -= X_DECREASING;
+        _LOG("Level updated at position %f\n", _worldOrigin.ToAbsolute(playerPos->getPosition().x))
+        MaterializeAround(playerPos->getPosition().x);
     }
 
     void HandleGameOver()
     {
-        for (entity_id_t entity : this->_turrets)
-        {
-            _LOG("Destroying called from line %d\n", __LINE__);
-            entityManager.DestroyEntityObject(entity);
-        }
-        this->_turrets.clear();
+        for (int64_t chunk = _firstChunk; chunk < _lastChunk; chunk++)
+            _work.Push(ChunkWork { chunk, false });
+        _firstChunk = _lastChunk = 0;
     }
 
     void HandlePlayerSpawned (PlayerSpawned* event)
@@ -1301,14 +2312,23 @@ class LevelGenSystem: public System<LevelGenSystem>, public IEventListener //Gam
 
 public:
 
-    LevelGenSystem ():
-        _left_x(0),
-        _right_x(0),
+    LevelGenSystem (World& world, bool withGraphics):
+        System(world),
+        _firstChunk(0),
+        _lastChunk(0),
         _playerId(-1),
-        _turretTexture()
+        _levelsCount(0),
+        _turretTexture(),
+        _withGraphics(withGraphics),
+        _streamer(CHUNK_SIZE, TURRETS_INTERVAL, NO_TURRETS_ON_START)
     {
-        _updateInterval = CHUNK_SIZE / PLAYER_SPEED / 2;
-        _turretTexture.loadFromFile("media/gun.png");
+        _updateInterval = FRAMERATE;        // for the chunks left to the next updates
+        if (_withGraphics)
+            _turretTexture.loadFromFile("media/gun.png");
+        Receives<GameStarted, PlayerPassedChunk, GameOver, PlayerSpawned, PlayerDied>();
+        Writes<PositionComponent, OrientationComponent, DrawingComponent, ShootingComponent, CollideableComponent>();
+        ChangesStructure();
+        EventDriven();
     }
 
     virtual ~LevelGenSystem() {}
@@ -1318,13 +2338,11 @@ public:
         int size = this->_raisedEvents.size();
         for (int i = 0; i < size; i++)
         {
-            IEvent* event = eventManager.GetEvent(this->_raisedEvents[i]);
+            IEvent* event = _eventManager.GetEvent(this->_raisedEvents[i]);
             if (event->_eventTypeId == Event<GameStarted>::EVENT_TYPE_ID)   
                 HandleGameStarted();
             else if (event->_eventTypeId == Event<PlayerPassedChunk>::EVENT_TYPE_ID)   
                 HandlePlayerPassedChunk();
-            else if (event->_eventTypeId == Event<XReduced>::EVENT_TYPE_ID)   
-                HandleXReduced();
             else if (event->_eventTypeId == Event<GameOver>::EVENT_TYPE_ID)   
                 HandleGameOver();
             else if (event->_eventTypeId == Event<PlayerSpawned>::EVENT_TYPE_ID) 
@@ -1335,188 +2353,193 @@ public:
                 _LOG("ERROR in LevelGenSystem: unknown event %d\n", event->_eventTypeId);
 
 
-            eventManager.EventHandled(this->_raisedEvents[i], *this);
+            _eventManager.EventHandled(this->_raisedEvents[i], *this);
         }
 
         this->_raisedEvents.clear();
 
+        _work.Run([this] (const ChunkWork& work) { DoChunkWork(work); }, _itemsBudget, _timeBudget_ms);
+        _workLeft = _work.GetCount();
+
         return 0;
              
     }
 };
 
 
-class ExitGameSystem: public System<ExitGameSystem>, public IEventListener //ExitGame
+class ExitGameSystem: public CoroutineSystem<ExitGameSystem> //ExitGame
 { public:
 
-    ExitGameSystem()
+    ExitGameSystem (World& world):
+        CoroutineSystem(world)
     {
-        _updateInterval = FRAMERATE;
+        Receives<ExitGame>();
     }
 
     virtual ~ExitGameSystem() {}
 
-    virtual float Update() override
+    virtual SystemTask Run() override
     {
-        if (this->_raisedEvents.size() == 0)
-            return 0;
-
-        if (this->_raisedEvents.size() >  1)
-            _LOG("ERROR: Unexpected size of _raisedEvents in ExitGameSystem: %d\n", (int)(this->_raisedEvents.size()));
-
-        #ifndef DEBUG
-        systemManager.Break();
-        #else
-        id_t eventId = this->_raisedEvents[0];
-        if (eventManager.GetEvent(eventId)->_eventTypeId != Event<ExitGame>::EVENT_TYPE_ID)
-        {
-            _LOG("ERROR: unknown eventId in ExitGameSystem: %d\n", eventManager.GetEvent(eventId)->_eventTypeId);
-        }
-        else
-        {
-            systemManager.Break();
-        }
-        #endif
-
-        eventManager.EventHandled(this->_raisedEvents[0], *this);
-        this->_raisedEvents.pop_back();
-
-        return 0;
+        co_await events.Next<ExitGame>();
+        _systemManager.Break();
     }
 };
 
-class XReducingSystem: public System<XReducingSystem>, public IEventListener //XReducing
-{ public:
-
-    XReducingSystem()
-    {
-        _updateInterval = 15 * 60;
-    }
-
-    virtual ~XReducingSystem() {}
+// Only turrets in the activity region shoot. Dormant ones keep reloading, so a turret that
+// comes into the region shoots as soon as it would have, had it shot last time it could.
+// Cannonballs of a game that is over are destroyed within the system's budget an update
+class ShootingSystem: public System<ShootingSystem>, public IEventListener //GameStarted, GameOver, GamePaused, GameResumed
+{
+    int64_t _timeOfLastUpdate_nsec;
+    int64_t _timeOfPause_nsec;          // -1 if not paused
+    bool _onGame;                       // turrets left of a game that is over don't shoot
+    sf::Texture _cannonballTexture;
+    bool _withGraphics;
+    std::vector<entity_id_t> _active;
+    std::vector<ShootingComponent*> _turrets;
+    WorkQueue<entity_id_t> _teardown;   // cannonballs to destroy
+    std::vector<entity_id_t> _destroyed;
 
-    virtual float Update() override
+    // Ids may be reused by then, so only what is still deadly goes
+    void Teardown (int itemsBudget, float timeBudget_ms)
     {
-        if (this->_raisedEvents.size() >  1)
-            _LOG("ERROR: Unexpected size of _raisedEvents in XReducingSystem: %d\n", (int)(this->_raisedEvents.size()));
-
-        if (this->_raisedEvents.size() == 0)
-            return 0;
-
-        #ifdef DEBUG
-        id_t eventId = this->_raisedEvents[0];
-        if (eventManager.GetEvent(eventId)->_eventTypeId != Event<XReducing>::EVENT_TYPE_ID)
+        _destroyed.clear();
+        _teardown.Run([this] (entity_id_t entity)
         {
-            _LOG("ERROR: unknown eventId in XReducingSystem: %d\n", eventManager.GetEvent(eventId)->_eventTypeId);
-        }
-        #endif
-
-        auto positions = componentManager.GetEntitiesVector<PositionComponent>();
+            if (_componentManager.GetComponent<DeadlyComponent>(entity))
+                _destroyed.push_back(entity);
+        }, itemsBudget, timeBudget_ms);
 
-        for (auto position: positions)
+        if (!_destroyed.empty())
         {
-            #ifdef DEBUG
-            if (((PositionComponent*)position)->getPosition().x < X_DECREASING)
-            {
-                _LOG("WARNING: position of entity no %d is less than X_DECREASING, but decreased\n", ((PositionComponent*)position)->_owner);
-            }
-            #endif
-
-            ((PositionComponent*)position)->getPosition().x -= X_DECREASING;
-
+            _LOG("Destroying called from line %d\n", __LINE__);
+            _entityManager.DestroyEntityObjects(_destroyed);
         }
-
-        eventManager.SendEvent<XReduced>();
-
-        return 0;
-        
+        _workLeft = _teardown.GetCount();
     }
-};
 
-class ShootingSystem: public System<ShootingSystem>, public IEventListener //GameOver
-{
-    struct timespec _timeOfLastUpdate;
-    struct timespec _timeOfNextShot;
-    sf::Texture _cannonballTexture;
+    // Turrets don't reload on pause: their timers are shifted by its length on resume
+    void ShiftTimers (int64_t delta_nsec)
+    {
+        jobSystem.ParallelForEach<ShootingComponent>(_componentManager, [delta_nsec] (ShootingComponent& shooting)
+        {
+            shooting._timeOfLastShot_nsec += delta_nsec;
+        });
+    }
 
-    bool IfGameIsOver()
+    void CheckEvents()
     {
         int size = this->_raisedEvents.size();
         for (int i = 0; i < size; i++)
         {
-            IEvent* ievent = eventManager.GetEvent(this->_raisedEvents[i]);
-            GameOver* event = dynamic_cast<GameOver*>(ievent);
-            assert(event);
-
-            std::vector<IComponent*> deadlyComponents = componentManager.GetEntitiesVector<DeadlyComponent>();
-            for (IComponent* comp : deadlyComponents)
+            IEvent* event = _eventManager.GetEvent(this->_raisedEvents[i]);
+            if (event->_eventTypeId == Event<GameOver>::EVENT_TYPE_ID)
             {
-                if (comp == nullptr) continue;
+                std::vector<IComponent*> deadlyComponents = _componentManager.GetEntitiesVector<DeadlyComponent>();
+                for (IComponent* comp : deadlyComponents)
+                {
+                    if (comp == nullptr) continue;
 
-                entityManager.DestroyEntityObject (comp->_owner);
+                    _teardown.Push(comp->_owner);
+                }
+                _timeOfPause_nsec = -1;
+                _onGame = false;
+            }
+            else if (event->_eventTypeId == Event<GameStarted>::EVENT_TYPE_ID)
+            {
+                // what is left of the last game goes at once
+                Teardown(0, 0.f);
+                _onGame = true;
+            }
+            else if (event->_eventTypeId == Event<GamePaused>::EVENT_TYPE_ID)
+            {
+                _timeOfPause_nsec = _worldClock.Now_nsec();
+            }
+            else if (event->_eventTypeId == Event<GameResumed>::EVENT_TYPE_ID)
+            {
+                if (_timeOfPause_nsec != -1)
+                    ShiftTimers (_worldClock.Now_nsec() - _timeOfPause_nsec);
+                _timeOfPause_nsec = -1;
+            }
+            else
+            {
+                _LOG("Unknown event type in ShootingSystem: %d\n", event->_eventTypeId);
             }
 
-
-            eventManager.EventHandled(this->_raisedEvents[i], *this);
+            _eventManager.EventHandled(this->_raisedEvents[i], *this);
         }
         this->_raisedEvents.clear();
-        return size > 0;
     }
 
 public:
 
-    ShootingSystem():
-        _timeOfLastUpdate({}),
-        _timeOfNextShot({-1, -1}),
-        _cannonballTexture()
+    ShootingSystem (World& world, bool withGraphics):
+        System(world),
+        _timeOfLastUpdate_nsec(_worldClock.Now_nsec()),
+        _timeOfPause_nsec(-1),
+        _onGame(false),
+        _cannonballTexture(),
+        _withGraphics(withGraphics)
     {
-        clock_gettime(CLOCK, &_timeOfLastUpdate);
         _updateInterval = FRAMERATE;
-        _cannonballTexture.loadFromFile("media/ball.png");
+        if (_withGraphics)
+            _cannonballTexture.loadFromFile("media/ball.png");
+        Receives<GameStarted, GameOver, GamePaused, GameResumed>();
+        Writes<ShootingComponent, PositionComponent, OrientationComponent, DrawingComponent, MovingComponent,     // spawns and destroys cannonballs
+               BouncingComponent, CollideableComponent, DeadlyComponent, FastMoverComponent>();
+        ChangesStructure();
+        WakesOnChangeOf<ShootingComponent>();
     }
 
     virtual ~ShootingSystem() {}
 
     virtual float Update() override
     {
-        if (IfGameIsOver())
-            return FRAMERATE;
-
-        struct timespec currentTime = {};
-        clock_gettime(CLOCK, &currentTime);
-
-        int64_t timebetw = GetTimeBetween_nsec (currentTime, _timeOfNextShot);
-        if (timebetw > 0)
+        CheckEvents();
+        if (!_teardown.IsEmpty())
+            Teardown(_itemsBudget, _timeBudget_ms);
+        if (!_onGame)
+            return INFINITY;            // till the next game, or the next update while cannonballs are left
+
+        if (_timeOfPause_nsec != -1 || _componentManager.GetComponentsCount<ShootingComponent>() == 0)
+            return INFINITY;            // till the game is resumed or turrets are spawned
+
+        int64_t currentTime_nsec = _worldClock.Now_nsec();
+
+        // turrets come into the region as it moves, so it is looked at every update
+        const std::vector<IComponent*>& shootingComponents = _componentManager.GetEntitiesVector<ShootingComponent>();
+        int shootingCount = shootingComponents.size();
+        _active.clear();
+        _activityRegion.Query(_spatialGrid, _active);
+        _turrets.clear();
+        for (entity_id_t entity : _active)
+            if (entity < shootingCount && shootingComponents[entity])
+                _turrets.push_back(static_cast<ShootingComponent*>(shootingComponents[entity]));
+
+        // Timers are scanned in parallel, each thread into its own slot; shots spawn entities, so they are fired afterwards
+        int threadsCount = jobSystem.GetThreadsCount();
+        std::vector<std::vector<ShootingComponent*>> readyToShoot_byThread (threadsCount);
+
+        jobSystem.ParallelFor(0, (int)_turrets.size(), [&] (int i)
         {
-            _timeOfLastUpdate = currentTime;
-            return 0;
-        }
+            int thread = jobSystem.GetWorkerIndex() < 0 ? 0 : jobSystem.GetWorkerIndex();
 
-        std::vector<IComponent*> shootings = componentManager.GetEntitiesVector<ShootingComponent>();
+            ShootingComponent& shooting = *_turrets[i];
+            if (currentTime_nsec - shooting._timeOfLastShot_nsec > SHOOTING_SPEED * 1000000000LL)
+                readyToShoot_byThread[thread].push_back(&shooting);
+        });
 
-        int size = shootings.size();
-        int64_t timeToNextShoot_nsec = SHOOTING_SPEED * 1000000000LL;
+        std::vector<ShootingComponent*> readyToShoot;
+        for (int thread = 0; thread < threadsCount; thread++)
+            readyToShoot.insert(readyToShoot.end(), readyToShoot_byThread[thread].begin(), readyToShoot_byThread[thread].end());
 
-        for (entity_id_t entityId = 0; entityId < size; entityId++)
-        {
-            ShootingComponent* shooting = dynamic_cast<ShootingComponent*>(shootings[entityId]);
+        // same order of spawned entities whatever the threads count is
+        std::sort(readyToShoot.begin(), readyToShoot.end(),
+                  [] (const ShootingComponent* lhs, const ShootingComponent* rhs) { return lhs->_owner < rhs->_owner; });
+        for (ShootingComponent* shooting : readyToShoot)
+            shooting->Shoot (GetWorld(), currentTime_nsec, _withGraphics ? &(this->_cannonballTexture) : nullptr);
 
-            if (shooting == nullptr)
-                continue;
-
-            int64_t thou_timeToNextShoot_nsec = SHOOTING_SPEED * 1000000000LL - GetTimeBetween_nsec (shooting->_timeOfLastShot, currentTime);
-            if (thou_timeToNextShoot_nsec < 0)
-            {
-                shooting->Shoot (currentTime, &(this->_cannonballTexture));
-            }
-            else if (thou_timeToNextShoot_nsec < timeToNextShoot_nsec)
-                timeToNextShoot_nsec = thou_timeToNextShoot_nsec;
-        }
-
-        _timeOfNextShot = currentTime;
-        _timeOfNextShot.tv_nsec += timeToNextShoot_nsec % 1000000000LL;
-        _timeOfNextShot.tv_sec  += timeToNextShoot_nsec / 1000000000LL;
-        _timeOfLastUpdate = currentTime;
+        _timeOfLastUpdate_nsec = currentTime_nsec;
 
         return 0;
     }
@@ -1524,18 +2547,31 @@ public:
 };
 
 
-void Runtime()
+// world: the one to set up and run
+// headless: no window, no textures and no sleeping, input is taken from inputScript
+// pipelined: RenderSystem draws on its own thread, overlapping the next simulation frame
+// simulationRate: if > 0, movement and wall collisions run in fixed steps at this rate
+// whatever the frame rate is, and rendering interpolates between the steps
+// activityRadius: entities farther from the player are dormant
+bool Runtime (World& world, bool headless, const char* inputScript, bool pipelined, float simulationRate, float activityRadius)
 {
+    SystemManager& systemManager = *world._systemManager;
+    EventManager& eventManager = *world._eventManager;
 
     auto 
     system = dynamic_cast<IEventListener*> (systemManager.AddSystem<MovingSystem>());
     eventManager.Subscribe<PlayerSpawned>    (system);
     eventManager.Subscribe<GameOver>         (system);
+    eventManager.Subscribe<GamePaused>       (system);
+    eventManager.Subscribe<GameResumed>      (system);
 
-    system = dynamic_cast<IEventListener*> (systemManager.AddSystem<ShootingSystem>());
+    system = dynamic_cast<IEventListener*> (systemManager.AddSystem<ShootingSystem>(!headless));
+    eventManager.Subscribe<GameStarted>      (system);
     eventManager.Subscribe<GameOver>         (system);
+    eventManager.Subscribe<GamePaused>       (system);
+    eventManager.Subscribe<GameResumed>      (system);
     
-    system = dynamic_cast<IEventListener*> (systemManager.AddSystem<HealthSystem>());
+    system = dynamic_cast<IEventListener*> (systemManager.AddSystem<HealthSystem>(!headless));
     eventManager.Subscribe<EntityHurt>       (system);
     eventManager.Subscribe<GameStarted>      (system);
     eventManager.Subscribe<GameOver>         (system);
@@ -1546,22 +2582,35 @@ void Runtime()
     eventManager.Subscribe<PlayerSpawned>    (system);
     eventManager.Subscribe<GameOver>         (system);
 
-    auto render = systemManager.AddSystem<RenderSystem>();
+    RenderSystem* render = nullptr;
+    if (headless)
+    {
+        if (!systemManager.AddSystem<ScriptedInputSystem>()->LoadScript(inputScript))
+        {
+            fprintf(stderr, "Can't read input script %s\n", inputScript);
+            return false;
+        }
+    }
+    else
+    {
+        render = systemManager.AddSystem<RenderSystem>(pipelined);
 
-    system = dynamic_cast<IEventListener*> (render);
-    eventManager.Subscribe<GameStarted>      (system);
-    eventManager.Subscribe<GameOver>         (system);
-    eventManager.Subscribe<PausedOrResumed>  (system);
-    eventManager.Subscribe<PlayerSpawned>    (system);
-    eventManager.Subscribe<PlayerDied>       (system);
+        system = dynamic_cast<IEventListener*> (render);
+        eventManager.Subscribe<GameStarted>      (system);
+        eventManager.Subscribe<GameOver>         (system);
+        eventManager.Subscribe<GamePaused>       (system);
+        eventManager.Subscribe<GameResumed>      (system);
+        eventManager.Subscribe<PlayerSpawned>    (system);
+        eventManager.Subscribe<PlayerDied>       (system);
+        eventManager.Subscribe<WindowExposed>    (system);
 
-    sf::RenderWindow* window = render->GetWindow();
-    systemManager.AddSystem<UserInputSystem>(window);
+        sf::RenderWindow* window = render->GetWindow();
+        systemManager.AddSystem<UserInputSystem>(window);
+    }
 
-    system = dynamic_cast<IEventListener*> (systemManager.AddSystem<LevelGenSystem>());
+    system = dynamic_cast<IEventListener*> (systemManager.AddSystem<LevelGenSystem>(!headless));
     eventManager.Subscribe<GameStarted>      (system);
     eventManager.Subscribe<GameOver>         (system);
-    eventManager.Subscribe<XReduced>         (system);
     eventManager.Subscribe<PlayerPassedChunk>(system);
     eventManager.Subscribe<PlayerSpawned>    (system);
     eventManager.Subscribe<PlayerDied>       (system);
@@ -1569,8 +2618,13 @@ void Runtime()
     system = dynamic_cast<IEventListener*> (systemManager.AddSystem<ExitGameSystem>());
     eventManager.Subscribe<ExitGame>         (system);
 
-    system = dynamic_cast<IEventListener*> (systemManager.AddSystem<WallCollisionSystem>());
-    eventManager.Subscribe<WallCollision>    (system);
+    system = dynamic_cast<IEventListener*> (systemManager.AddSystem<CollisionSystem>());
+    eventManager.Subscribe<GamePaused>       (system);
+    eventManager.Subscribe<GameResumed>      (system);
+    eventManager.Subscribe<GameOver>         (system);
+
+    system = dynamic_cast<IEventListener*> (systemManager.AddSystem<ImpactSystem>());
+    eventManager.Subscribe<Contacts>         (system);
 
     system = dynamic_cast<IEventListener*> (systemManager.AddSystem<GameStateSystem>());
     eventManager.Subscribe<EnterPressed>     (system);
@@ -1580,35 +2634,122 @@ void Runtime()
 
 
 
-    systemManager.SetPriority<GameStateSystem>(10);
-    systemManager.SetPriority<WallCollisionSystem>(9);
-    systemManager.SetPriority<ExitGameSystem>(8);
-    systemManager.SetPriority<LevelGenSystem>(7);
-    systemManager.SetPriority<UserInputSystem>(6);
-    systemManager.SetPriority<RenderSystem>(5);
-    systemManager.SetPriority<DrivingSystem>(4);
-    systemManager.SetPriority<HealthSystem>(3);
-    systemManager.SetPriority<MovingSystem>(2);
-    systemManager.SetPriority<ShootingSystem>(1);
-    
+    systemManager.SetPriority<GameStateSystem>(11);
+    systemManager.SetPriority<ImpactSystem>(10);
+    systemManager.SetPriority<ExitGameSystem>(9);
+    systemManager.SetPriority<LevelGenSystem>(8);
+    systemManager.SetPriority<UserInputSystem>(7);
+    systemManager.SetPriority<ScriptedInputSystem>(7);
+    systemManager.SetPriority<DrivingSystem>(6);
+    systemManager.SetPriority<HealthSystem>(5);
+    systemManager.SetPriority<MovingSystem>(4);
+    systemManager.SetPriority<CollisionSystem>(3);
+    systemManager.SetPriority<ShootingSystem>(2);
+    systemManager.SetPriority<RenderSystem>(1);         // after the frame's fixed steps, which it interpolates
+
+    // chunks and cannonballs an update, after the end of a game
+    systemManager.SetBudget<LevelGenSystem>(4);
+    systemManager.SetBudget<ShootingSystem>(64);
+
+    world._origin->SetChunkSize(CHUNK_SIZE);
+    world._spatialGrid->SetCellSize(CHUNK_SIZE);
+    world._activity->SetRadius(activityRadius);
+
+    if (simulationRate > 0)
+    {
+        systemManager.SetFixedStep<MovingSystem>(1.f / simulationRate);
+        systemManager.SetFixedStep<CollisionSystem>(1.f / simulationRate);
+    }
 
     float toSleep = 0.f;
-    while (!std::isnan(toSleep))
+    if (headless)
+    {
+        // instead of sleeping, the clock jumps straight to the next due system
+        world._clock->SetManual();
+        while (!std::isnan(toSleep) && !std::isinf(toSleep))
+        {
+            world._clock->Advance((int64_t)(toSleep * 1000000));
+            toSleep = systemManager.Update();
+        }
+    }
+    else
     {
-        if (toSleep > 10000.f) _LOG("WARNING: toSleep is too big: %f (%d, %X)\n", toSleep, (int)(toSleep), (int)(toSleep));
-        usleep((unsigned)(toSleep * 1000));
-        toSleep = systemManager.Update();
-        //printf("%f\n", toSleep);
+        FramePacer pacer (0.f, 0.00025f);      // no rate limit besides system intervals, spin the last 0.25 ms
+        while (!std::isnan(toSleep))
+        {
+            if (toSleep > 10000.f) _LOG("WARNING: toSleep is too big: %f (%d, %X)\n", toSleep, (int)(toSleep), (int)(toSleep));
+            pacer.WaitNextFrame(toSleep);
+            toSleep = systemManager.Update();
+            //printf("%f\n", toSleep);
+        }
+
+        render->StopRendering();
+
+        #ifdef PROFILING
+        pacer.PrintStatistics(stdout);
+        #endif
     }
+
+    PROFILE_EXPORT_TRACE("profile.json")
+    PROFILE_PRINT_SUMMARY(stdout)
+    return true;
+}
+
+// Runs worldsCount headless simulations at once, each in its own world on its own thread.
+// The job system isn't started: every world updates its systems serially on its thread
+bool RunWorlds (int worldsCount, const char* inputScript, float simulationRate, float activityRadius)
+{
+    std::vector<std::thread> threads;
+    std::vector<char> succeeded (worldsCount, false);
+    for (int i = 0; i < worldsCount; i++)
+        threads.emplace_back([i, inputScript, simulationRate, activityRadius, &succeeded]
+        {
+            World world;
+            World::Scope scope (world);
+            world.Setup();
+            succeeded[i] = Runtime(world, true, inputScript, false, simulationRate, activityRadius);
+        });
+
+    for (std::thread& thread : threads)
+        thread.join();
+    return std::find(succeeded.begin(), succeeded.end(), false) == succeeded.end();
 }
 
-int main()
+// Usage: game [--pipelined] [--sim-rate <Hz>] [--activity-radius <pix>] [--headless [--worlds <count>] [input script]]
+int main (int argc, char** argv)
 { 
+    bool headless = false;
+    bool pipelined = false;
+    float simulationRate = 0.f;
+    float activityRadius = ACTIVITY_RADIUS;
+    int worldsCount = 1;
+    const char* inputScript = ScriptedInputSystem::DEFAULT_SCRIPT;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--headless"))
+            headless = true;
+        else if (!strcmp(argv[i], "--pipelined"))
+            pipelined = true;
+        else if (!strcmp(argv[i], "--sim-rate") && i + 1 < argc)
+            simulationRate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--activity-radius") && i + 1 < argc)
+            activityRadius = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--worlds") && i + 1 < argc)
+            worldsCount = atoi(argv[++i]);
+        else if (headless)
+            inputScript = argv[i];
+    }
+
     fclose(fopen("debug.log", "w"));
     _LOG("%d", (int)(std::isnan(NAN)));
-    SetupManagers();
     auto begin = std::chrono::high_resolution_clock::now();
-    Runtime();
+    if (headless && worldsCount > 1)
+        return RunWorlds(worldsCount, inputScript, simulationRate, activityRadius) ? 0 : 1;
+
+    SetupManagers();
+    jobSystem.Start(std::thread::hardware_concurrency());
+    if (!Runtime(mainWorld, headless, inputScript, pipelined, simulationRate, activityRadius))
+        return 1;
 
 }
 